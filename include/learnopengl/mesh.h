@@ -7,7 +7,18 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/bounds.h>
+#include <rg/geometry_pool.h>
+#include <rg/lod.h>
+#include <rg/material.h>
+#include <rg/mesh_optimizer.h>
+#include <rg/mesh_simplifier.h>
+#include <rg/model_cache.h>
+#include <rg/service_locator.h>
+#include <rg/vertex_format.h>
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 using namespace std;
@@ -29,94 +40,269 @@ struct Vertex {
 
 struct Texture {
     unsigned int id;
-    string type;
+    rg::TextureType type;
     string path;
 };
 
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data; both stay empty for meshes uploaded from a cooked model cache
     vector<Vertex>       vertices;
+    // the index ranges of all levels of detail, full detail first
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    vector<rg::MeshLod>  lods;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
+    // object space bounds of the vertices, computed once at construction
+    rg::AABB bounds;
+    rg::BoundingSphere sphere;
+
+    // layout of the vertex buffer; packed positions are relative to the bounds
+    rg::VertexFormat vertexFormat;
+    rg::VertexQuantization quantization;
+
+    // pooled meshes share the VAO of their arena; indices are relative to baseVertex and
+    // start at firstIndex, standalone meshes have both at 0
+    unsigned int VAO = 0;
+    rg::MeshStorage storage;
+    int baseVertex = 0;
+    unsigned int firstIndex = 0;
+    // the index buffer holds 16-bit indices whenever they can address every vertex
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // what the mesh is drawn with; meshes sharing one batch together. Not owned, may be null
+    rg::Material *material = nullptr;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         const rg::LodSettings &lodSettings = rg::NO_LODS,
+         rg::VertexFormat vertexFormat = rg::VertexFormat::Packed,
+         rg::MeshStorage storage = rg::MeshStorage::Pooled)
+        : Mesh(Prepare(std::move(vertices), std::move(indices), std::move(textures), lodSettings,
+                       vertexFormat, storage))
+    {
+        Upload();
+    }
+
+    // everything the buffers are made from, without touching GL, so it can run on a worker
+    // thread; Upload creates the buffers later on the GL thread
+    static Mesh Prepare(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+                        const rg::LodSettings &lodSettings = rg::NO_LODS,
+                        rg::VertexFormat vertexFormat = rg::VertexFormat::Packed,
+                        rg::MeshStorage storage = rg::MeshStorage::Pooled)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        Mesh mesh(vertexFormat, storage);
+        mesh.vertices = std::move(vertices);
+        mesh.indices = std::move(indices);
+        mesh.textures = std::move(textures);
+
+        mesh.computeBounds();
+        if (vertexFormat == rg::VertexFormat::Packed)
+            mesh.quantization = rg::VertexQuantization::fromBounds(mesh.bounds);
+        mesh.generateLods(lodSettings);
+        mesh.indexType = mesh.vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        return mesh;
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // now that we have all the required data, set the vertex buffers and its attribute pointers.
+    void Upload()
+    {
+        vector<std::byte> vertexData = VertexBufferData();
+        vector<std::byte> indexData = IndexBufferData();
+        setupMesh(vertexData.data(), vertices.size(), indexData.data(), indices.size());
+    }
+
+    // uploads a mesh read from a model cache; the buffers are copied straight from the mapping
+    Mesh(const rg::CookedMesh &cooked, vector<Texture> textures,
+         rg::MeshStorage storage = rg::MeshStorage::Pooled)
+        : textures(std::move(textures)), bounds(cooked.header.bounds), sphere(cooked.header.sphere),
+          vertexFormat(static_cast<rg::VertexFormat>(cooked.header.vertexFormat)),
+          quantization(cooked.header.quantization), storage(storage), indexType(cooked.header.indexType)
+    {
+        lods.assign(cooked.header.lods, cooked.header.lods + cooked.header.lodCount);
+        setupMesh(cooked.vertexData.data(), cooked.header.vertexCount, cooked.indexData.data(),
+                  cooked.header.indexCount);
+    }
+
+    std::size_t VertexSize() const
+    {
+        return vertexFormat == rg::VertexFormat::Packed ? sizeof(rg::PackedVertex) : sizeof(Vertex);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // the vertices as they are uploaded: packed or as they are. The bitangent is not
+    // packed, the shaders rebuild it from the normal, the tangent and the handedness.
+    vector<std::byte> VertexBufferData() const
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        vector<std::byte> data(vertices.size() * VertexSize());
+        if (vertexFormat == rg::VertexFormat::Float)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // A great thing about structs is that their memory layout is sequential for all its items.
+            // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+            // again translates to 3/2 floats which translates to a byte array.
+            std::memcpy(data.data(), vertices.data(), data.size());
+            return data;
         }
+        for (std::size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &vertex = vertices[i];
+            rg::PackedVertex packed = rg::packVertex(vertex.Position, vertex.Normal, vertex.TexCoords,
+                                                     vertex.Tangent, vertex.Bitangent, quantization);
+            std::memcpy(data.data() + i * sizeof(packed), &packed, sizeof(packed));
+        }
+        return data;
+    }
 
+    // the indices of all levels of detail as they are uploaded, in indexType
+    vector<std::byte> IndexBufferData() const
+    {
+        vector<std::byte> data(indices.size() * indexSize());
+        if (indexType == GL_UNSIGNED_INT)
+        {
+            std::memcpy(data.data(), indices.data(), data.size());
+            return data;
+        }
+        for (std::size_t i = 0; i < indices.size(); i++)
+        {
+            std::uint16_t index = static_cast<std::uint16_t>(indices[i]);
+            std::memcpy(data.data() + i * sizeof(index), &index, sizeof(index));
+        }
+        return data;
+    }
 
+    // binds the material and the VAO and sets the vertex decoding uniforms; bindings are
+    // left in place, the state cache drops them if the next draw uses the same ones
+    void Bind(Shader &shader)
+    {
+        if (material != nullptr)
+            material->bind();
+        setVertexDecoding(shader);
+        rg::ServiceLocator::Get().getGLState().bindVertexArray(VAO);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // render instanceCount copies of level of detail lod in a single draw call. The
+    // per-instance model matrices are read from the instance buffer attached to this mesh's VAO.
+    void DrawInstanced(Shader &shader, GLsizei instanceCount, unsigned int lod = 0)
+    {
+        Bind(shader);
+        const rg::MeshLod &level = lods[lod];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, level.indexCount, indexType,
+                                          (void*)((firstIndex + level.indexOffset) * indexSize()),
+                                          instanceCount, baseVertex);
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // the same draw as DrawInstanced, for glMultiDrawElementsIndirect; baseInstance offsets
+    // the instance attributes
+    rg::DrawElementsIndirectCommand IndirectCommand(unsigned int lod, GLuint instanceCount,
+                                                    GLuint baseInstance) const
+    {
+        const rg::MeshLod &level = lods[lod];
+        return rg::DrawElementsIndirectCommand{level.indexCount, instanceCount, firstIndex + level.indexOffset,
+                                               baseVertex, baseInstance};
     }
 
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+
+    Mesh(rg::VertexFormat vertexFormat, rg::MeshStorage storage)
+        : vertexFormat(vertexFormat), storage(storage)
+    {
+    }
+
+    std::size_t indexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t) : sizeof(unsigned int);
+    }
+
+    // the vertex shaders decode both layouts, these tell them which one this mesh uses
+    void setVertexDecoding(Shader &shader)
+    {
+        shader.set(shader.vertexDecoding.packedVertices, vertexFormat == rg::VertexFormat::Packed);
+        shader.set(shader.vertexDecoding.quantizationOffset, quantization.offset);
+        shader.set(shader.vertexDecoding.quantizationScale, quantization.scale);
+    }
+
+    // the sphere is centered on the box, its radius is the farthest vertex from that center
+    void computeBounds()
+    {
+        for (const Vertex &vertex : vertices)
+            bounds.extend(vertex.Position);
+        if (bounds.empty())
+            return;
+        sphere.center = bounds.center();
+        for (const Vertex &vertex : vertices)
+            sphere.radius = std::max(sphere.radius, glm::length(vertex.Position - sphere.center));
+    }
+
+    // appends the simplified levels to the index buffer; each one is simplified from the
+    // previous level, so errors add up
+    void generateLods(const rg::LodSettings &settings)
+    {
+        lods.push_back(rg::MeshLod{0, (unsigned int)indices.size(), 0.0f});
+        if (settings.levels == 0 || indices.size() / 3 < settings.minTriangles)
+            return;
+
+        vector<glm::vec3> positions;
+        positions.reserve(vertices.size());
+        for (const Vertex &vertex : vertices)
+            positions.push_back(vertex.Position);
+
+        vector<unsigned int> previous = indices;
+        for (unsigned int level = 1; level <= settings.levels && level < rg::MAX_MESH_LODS; level++)
+        {
+            std::size_t target = (std::size_t)(previous.size() / 3 * settings.reduction) * 3;
+            float error = 0.0f;
+            float budget = settings.maxError - lods.back().error;
+            if (budget <= 0.0f)
+                break;
+            vector<unsigned int> simplified = rg::simplifyMesh(positions, previous, target, budget, error);
+            // not worth a level if the budget stopped it early
+            if (simplified.empty() || simplified.size() > previous.size() * 9 / 10)
+                break;
+            // collapses leave holes in the cache order of the level they started from
+            rg::optimizeVertexCache(simplified, vertices.size());
+            lods.push_back(rg::MeshLod{(unsigned int)indices.size(), (unsigned int)simplified.size(),
+                                       lods.back().error + error});
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            previous = std::move(simplified);
+        }
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const void *vertexData, std::size_t vertexCount, const void *indexData, std::size_t indexCount)
     {
+        rg::GeometryPool::AttributeSetup setupAttributes =
+                vertexFormat == rg::VertexFormat::Packed ? setupPackedAttributes : setupFloatAttributes;
+        if (storage == rg::MeshStorage::Pooled)
+        {
+            rg::GeometryRange range = rg::ServiceLocator::Get().getGeometryPool().allocate(
+                    setupAttributes, vertexData, vertexCount, VertexSize(), indexData, indexCount, indexType);
+            VAO = range.VAO;
+            baseVertex = range.baseVertex;
+            firstIndex = range.firstIndex;
+            return;
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        rg::GLState &state = rg::ServiceLocator::Get().getGLState();
+        state.bindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * VertexSize(), vertexData, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize(), indexData, GL_STATIC_DRAW);
+
+        setupAttributes();
+        state.bindVertexArray(0);
+    }
 
-        // set the vertex attribute pointers
+    // set the vertex attribute pointers of the bound VAO to the bound array buffer
+    static void setupFloatAttributes()
+    {
         // vertex Positions
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -132,8 +318,22 @@ private:
         // vertex bitangent
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+    }
 
-        glBindVertexArray(0);
+    static void setupPackedAttributes()
+    {
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, sizeof(rg::PackedVertex),
+                              (void*)offsetof(rg::PackedVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(rg::PackedVertex),
+                              (void*)offsetof(rg::PackedVertex, normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(rg::PackedVertex),
+                              (void*)offsetof(rg::PackedVertex, texCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(rg::PackedVertex),
+                              (void*)offsetof(rg::PackedVertex, tangent));
     }
 };
 #endif
\ No newline at end of file
@@ -12,8 +12,17 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
-
+#include <rg/instance_buffer.h>
+#include <rg/mesh_optimizer.h>
+#include <rg/model_cache.h>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -21,77 +30,294 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false,
+                             rg::TextureUsage usage = rg::TextureUsage::Color);
+
 
 
+class PendingModel;
+
+// A model imported up to the point where GL objects are needed. Model::Import fills it on
+// any thread, the Model constructed from it creates the buffers and textures.
+struct ModelImport
+{
+    string directory;
+    bool gamma = false;
+    rg::LodSettings lodSettings;
+    rg::VertexFormat vertexFormat = rg::VertexFormat::Packed;
+    rg::MeshStorage storage = rg::MeshStorage::Pooled;
+    // prepared but not uploaded; their textures are only named yet
+    vector<Mesh> meshes;
+    // open when the meshes come from a cooked cache, they are uploaded straight from its mapping
+    rg::ModelCache cache;
+};
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// every texture reference taken by the meshes, released with the model
     vector<Mesh>    meshes;
+    // one per distinct set of textures among the meshes, see CreateMaterials
+    vector<std::unique_ptr<rg::Material>> materials;
     string directory;
     bool gammaCorrection;
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. Every mesh gets the levels of detail
+    // described by lodSettings and uploads its vertices in vertexFormat. Pooled meshes are
+    // suballocated from the shared geometry pool, so all of them draw from the same VAO.
+    Model(string const &path, bool gamma = false, const rg::LodSettings &lodSettings = {},
+          rg::VertexFormat vertexFormat = rg::VertexFormat::Packed,
+          rg::MeshStorage storage = rg::MeshStorage::Pooled)
+        : Model(Import(path, gamma, lodSettings, vertexFormat, storage))
     {
-        loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // creates the GL objects of an import, on the GL thread
+    explicit Model(ModelImport import)
+        : directory(import.directory), gammaCorrection(import.gamma), lodSettings(import.lodSettings),
+          vertexFormat(import.vertexFormat), storage(import.storage)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        for (const rg::CookedMesh &cooked : import.cache.meshes())
+        {
+            vector<Texture> textures;
+            for (const rg::CookedTexture &texture : cooked.textures)
+            {
+                if (std::optional<rg::TextureType> type = rg::textureTypeFromName(texture.type))
+                    textures.push_back(loadTexture(texture.path, *type));
+            }
+            meshes.emplace_back(cooked, textures, storage);
+        }
+        import.cache.close();
+        for (Mesh &mesh : import.meshes)
+        {
+            for (Texture &texture : mesh.textures)
+                texture = loadTexture(texture.path, texture.type);
+            mesh.Upload();
+            meshes.push_back(std::move(mesh));
+        }
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
-        }
+    ~Model()
+    {
+        releaseTextures();
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // the meshes point at the materials and the instance buffer, and the texture references
+    // are released once, so a model is only moved
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    Model(Model &&other) noexcept
+        : textures_loaded(std::exchange(other.textures_loaded, {})), meshes(std::move(other.meshes)),
+          materials(std::move(other.materials)), directory(std::move(other.directory)),
+          gammaCorrection(other.gammaCorrection), instanceBuffer(std::move(other.instanceBuffer)),
+          lodSettings(other.lodSettings), vertexFormat(other.vertexFormat), storage(other.storage)
+    {
+    }
+
+    Model &operator=(Model &&other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        releaseTextures();
+        textures_loaded = std::exchange(other.textures_loaded, {});
+        meshes = std::move(other.meshes);
+        materials = std::move(other.materials);
+        directory = std::move(other.directory);
+        gammaCorrection = other.gammaCorrection;
+        instanceBuffer = std::move(other.instanceBuffer);
+        lodSettings = other.lodSettings;
+        vertexFormat = other.vertexFormat;
+        storage = other.storage;
+        return *this;
+    }
+
+    // starts importing path on the thread pool and returns right away. Assimp and the mesh
+    // processing run on the workers, the meshes of one model in parallel as well; only the
+    // GL objects wait for PendingModel::Get.
+    static PendingModel LoadAsync(string const &path, bool gamma = false, const rg::LodSettings &lodSettings = {},
+                                  rg::VertexFormat vertexFormat = rg::VertexFormat::Packed,
+                                  rg::MeshStorage storage = rg::MeshStorage::Pooled);
+
+    // loads a model with supported ASSIMP extensions from file, up to the GL objects. Safe
+    // on any thread.
+    static ModelImport Import(string const &path, bool gamma = false, const rg::LodSettings &lodSettings = {},
+                              rg::VertexFormat vertexFormat = rg::VertexFormat::Packed,
+                              rg::MeshStorage storage = rg::MeshStorage::Pooled)
     {
+        ModelImport import;
+        // retrieve the directory path of the filepath
+        import.directory = path.substr(0, path.find_last_of('/'));
+        import.gamma = gamma;
+        import.lodSettings = lodSettings;
+        import.vertexFormat = vertexFormat;
+        import.storage = storage;
+
+        // the cooked cache of an earlier import skips Assimp and all mesh processing
+        string cachePath = path + ".rgcache";
+        std::uint64_t sourceHash = sourceFilesHash(path);
+        std::uint64_t settingsHash = importSettingsHash(lodSettings, vertexFormat);
+        if (sourceHash != 0 && import.cache.open(cachePath, sourceHash, settingsHash))
+            return import;
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            return import;
+        }
+
+        // process ASSIMP's root node recursively, then the meshes it lists in parallel
+        vector<const aiMesh*> sceneMeshes;
+        processNode(scene->mRootNode, scene, sceneMeshes);
+        vector<std::optional<Mesh>> prepared(sceneMeshes.size());
+        rg::ServiceLocator::Get().getThreadPool().parallelFor(sceneMeshes.size(), [&](std::size_t i) {
+            prepared[i].emplace(processMesh(sceneMeshes[i], scene, import));
+        });
+        for (std::optional<Mesh> &mesh : prepared)
+            import.meshes.push_back(std::move(*mesh));
+
+        if (sourceHash != 0)
+            writeCache(cachePath, sourceHash, settingsHash, import.meshes);
+        return import;
+    }
+
+    // draws the model, and thus all its meshes, once at model
+    void Draw(Shader &shader, const glm::mat4 &model)
+    {
+        DrawInstanced(shader, std::span<const glm::mat4>(&model, 1));
+    }
+
+    // draws one copy of the model per matrix in instances, with a single draw call per mesh
+    void DrawInstanced(Shader &shader, std::span<const glm::mat4> instances)
+    {
+        if (instances.empty())
             return;
+        instanceBuffer.upload(instances);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            // the render queue points the instance attributes at its own buffer
+            instanceBuffer.attach(meshes[i].VAO);
+            meshes[i].DrawInstanced(shader, instances.size());
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
+    }
+
+    // gives every mesh a lighting material drawn with variants; meshes with the same textures
+    // share one, so they batch together
+    void CreateMaterials(rg::ShaderVariants &variants, const rg::MaterialBlock &parameters = {})
+    {
+        materials.clear();
+        std::map<vector<unsigned int>, rg::Material*> byTextures;
+        for (Mesh &mesh : meshes)
+        {
+            vector<unsigned int> textureIds;
+            for (const Texture &texture : mesh.textures)
+                textureIds.push_back(texture.id);
+            rg::Material *&material = byTextures[textureIds];
+            if (material == nullptr)
+            {
+                materials.push_back(std::make_unique<rg::Material>(variants, mesh.textures, parameters));
+                material = materials.back().get();
+            }
+            mesh.material = material;
+        }
+    }
+private:
+    static constexpr unsigned int IMPORT_FLAGS =
+            aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    rg::InstanceBuffer instanceBuffer;
+    rg::LodSettings lodSettings;
+    rg::VertexFormat vertexFormat;
+    rg::MeshStorage storage;
+
+    // drops the references taken by the meshes
+    void releaseTextures()
+    {
+        rg::TextureCache &textureCache = rg::ServiceLocator::Get().getTextureCache();
+        for (const Texture &texture : textures_loaded)
+            textureCache.release(texture.id);
+        textures_loaded.clear();
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // the model file and the material library of the same name next to it, which is where
+    // OBJ exports put it; 0 when the model cannot be read
+    static std::uint64_t sourceFilesHash(string const &path)
     {
-        // process each mesh located at the current node
+        std::uint64_t hash = rg::hashFile(path);
+        if (hash == 0)
+            return 0;
+        std::uint64_t withMaterials = rg::hashFile(path.substr(0, path.find_last_of('.')) + ".mtl", hash);
+        return withMaterials != 0 ? withMaterials : hash;
+    }
+
+    // everything besides the source files that changes the cooked meshes
+    static std::uint64_t importSettingsHash(const rg::LodSettings &lodSettings, rg::VertexFormat vertexFormat)
+    {
+        std::uint64_t hash = rg::hashBytes(&IMPORT_FLAGS, sizeof(IMPORT_FLAGS));
+        hash = rg::hashBytes(&vertexFormat, sizeof(vertexFormat), hash);
+        hash = rg::hashBytes(&lodSettings.levels, sizeof(lodSettings.levels), hash);
+        hash = rg::hashBytes(&lodSettings.reduction, sizeof(lodSettings.reduction), hash);
+        hash = rg::hashBytes(&lodSettings.maxError, sizeof(lodSettings.maxError), hash);
+        return rg::hashBytes(&lodSettings.minTriangles, sizeof(lodSettings.minTriangles), hash);
+    }
+
+    static void writeCache(string const &cachePath, std::uint64_t sourceHash, std::uint64_t settingsHash,
+                           const vector<Mesh> &meshes)
+    {
+        // the cooked meshes only point at their buffers
+        vector<vector<std::byte>> buffers;
+        buffers.reserve(meshes.size() * 2);
+        vector<rg::CookedMesh> cooked(meshes.size());
+        for (std::size_t i = 0; i < meshes.size(); i++)
+        {
+            const Mesh &mesh = meshes[i];
+            rg::CookedMeshHeader &header = cooked[i].header;
+            header.vertexFormat = static_cast<std::uint32_t>(mesh.vertexFormat);
+            header.vertexCount = mesh.vertices.size();
+            header.vertexSize = mesh.VertexSize();
+            header.indexType = mesh.indexType;
+            header.indexCount = mesh.indices.size();
+            header.lodCount = mesh.lods.size();
+            std::copy(mesh.lods.begin(), mesh.lods.end(), header.lods);
+            header.bounds = mesh.bounds;
+            header.sphere = mesh.sphere;
+            header.quantization = mesh.quantization;
+            for (const Texture &texture : mesh.textures)
+                cooked[i].textures.push_back(rg::CookedTexture{rg::textureTypeName(texture.type), texture.path});
+            buffers.push_back(mesh.VertexBufferData());
+            cooked[i].vertexData = buffers.back();
+            buffers.push_back(mesh.IndexBufferData());
+            cooked[i].indexData = buffers.back();
+        }
+        if (!rg::ModelCache::write(cachePath, sourceHash, settingsHash, cooked))
+            cout << "ERROR::MODEL_CACHE:: could not write " << cachePath << endl;
+    }
+
+    // processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+    static void processNode(aiNode *node, const aiScene *scene, vector<const aiMesh*> &sceneMeshes)
+    {
+        // collect each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        // after we've collected all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, sceneMeshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // runs on worker threads, the scene is only read
+    static Mesh processMesh(const aiMesh *mesh, const aiScene *scene, const ModelImport &import)
     {
         // data to fill
         vector<Vertex> vertices;
@@ -101,7 +327,8 @@ private:
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            // zero initialized, welding compares whole vertices including the attributes left unset
+            Vertex vertex{};
             glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -153,9 +380,8 @@ private:
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
-        // Same applies to other texture as the following list summarizes:
+        // the shaders sample every texture as texture_<type>N, where N counts from 1 up to
+        // rg::MAX_TEXTURES_PER_TYPE, see rg::TextureType:
         // diffuse: texture_diffuseN
         // specular: texture_specularN
         // normal: texture_normalN
@@ -164,96 +390,173 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, rg::TextureType::Diffuse);
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, rg::TextureType::Specular);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, rg::TextureType::Normal);
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, rg::TextureType::Height);
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        // 5. occlusion, roughness and metallic maps, packed into one texture
+        textures.push_back(loadPackedMaterialTexture(material));
 
-
+        // the levels of detail are simplified from the optimized mesh
+        optimizeMesh(vertices, indices);
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh::Prepare(std::move(vertices), std::move(indices), std::move(textures), import.lodSettings,
+                             import.vertexFormat, import.storage);
+    }
+
+    // welds identical vertices, orders the triangles for the post-transform vertex cache and
+    // then for overdraw, and finally orders the vertices by first use for fetch locality
+    static void optimizeMesh(vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        std::size_t importedVertices = vertices.size();
+        float importedACMR = rg::computeACMR(indices, vertices.size());
+
+        vector<unsigned int> remap(vertices.size());
+        std::size_t uniqueVertices = rg::generateVertexRemap(remap, vertices.data(), vertices.size(), sizeof(Vertex));
+        vertices = rg::remapVertices(vertices, remap, uniqueVertices);
+        rg::remapIndices(indices, remap);
+
+        rg::optimizeVertexCache(indices, vertices.size());
+        vector<glm::vec3> positions;
+        positions.reserve(vertices.size());
+        for (const Vertex &vertex : vertices)
+            positions.push_back(vertex.Position);
+        rg::optimizeOverdraw(indices, positions);
+
+        remap.resize(vertices.size());
+        std::size_t usedVertices = rg::generateFetchRemap(remap, indices);
+        vertices = rg::remapVertices(vertices, remap, usedVertices);
+        rg::remapIndices(indices, remap);
+
+        rg::recordMeshOptimization(importedVertices, vertices.size(), importedACMR,
+                                   rg::computeACMR(indices, vertices.size()), indices.size() / 3);
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // names the material textures of a given type; the GL thread loads them when the model
+    // is built. The required info is returned as a Texture struct.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, rg::TextureType textureType)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(Texture{0, textureType, str.C_Str()});
         }
         return textures;
     }
-};
 
+    // the path of the first texture of type in the material, empty if there is none
+    static string materialTexturePath(aiMaterial *mat, aiTextureType type)
+    {
+        if (mat->GetTextureCount(type) == 0)
+            return string();
+        aiString str;
+        mat->GetTexture(type, 0, &str);
+        return str.C_Str();
+    }
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
+    // names the sources of the material's ORM texture as occlusion|roughness|metallic, any
+    // of them empty when the material has no such map. Every material gets one, so the
+    // shaders need no variant without it; the defaults keep plain materials lit as before.
+    static Texture loadPackedMaterialTexture(aiMaterial *mat)
+    {
+        string occlusion = materialTexturePath(mat, aiTextureType_LIGHTMAP);
+        // OBJ files name roughness maps map_Ns and metallic maps refl
+        string roughness = materialTexturePath(mat, aiTextureType_SHININESS);
+        string metallic = materialTexturePath(mat, aiTextureType_REFLECTION);
+        return Texture{0, rg::TextureType::ORM, occlusion + '|' + roughness + '|' + metallic};
+    }
+
+    // loads the texture at path, relative to the model directory, through the process-wide
+    // texture cache, which shares it with every other model using the same file
+    Texture loadTexture(string const &path, rg::TextureType type)
+    {
+        if (type == rg::TextureType::ORM)
+            return loadPackedTexture(path);
+        // the type tells how the texture is compressed
+        rg::TextureUsage usage = rg::TextureUsage::Color;
+        if (type == rg::TextureType::Normal)
+            usage = rg::TextureUsage::Normal;
+        else if (type == rg::TextureType::Height)
+            usage = rg::TextureUsage::Height;
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), this->directory, false, usage);
+        texture.type = type;
+        texture.path = path;
+        textures_loaded.push_back(texture);  // each entry holds one cache reference, dropped with the model
+        return texture;
+    }
+
+    // the packed texture named by loadPackedMaterialTexture
+    Texture loadPackedTexture(string const &path)
+    {
+        // unoccluded, smooth and dielectric where a map is missing
+        const unsigned char defaults[3] = {255, 0, 0};
+        std::vector<rg::ChannelSource> channels(3);
+        std::istringstream sources(path);
+        string source;
+        for (std::size_t i = 0; i < channels.size(); i++)
+        {
+            channels[i].value = defaults[i];
+            if (std::getline(sources, source, '|') && !source.empty())
+                channels[i].path = this->directory + '/' + source;
+        }
+        Texture texture;
+        texture.id = rg::ServiceLocator::Get().getTextureCache().acquirePacked(channels);
+        texture.type = rg::TextureType::ORM;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
+    }
+};
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+// Handle to a model importing on the thread pool, like a future of the model. Get waits
+// for the import and creates the GL objects, so it belongs on the GL thread.
+class PendingModel
+{
+public:
+    explicit PendingModel(std::future<ModelImport> import) : import(std::move(import)) {}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // true once Get no longer waits for the workers
+    bool Ready() const
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        return import.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
     }
-    else
+
+    // only once per handle
+    Model Get()
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        return Model(import.get());
     }
 
-    return textureID;
+private:
+    std::future<ModelImport> import;
+};
+
+inline PendingModel Model::LoadAsync(string const &path, bool gamma, const rg::LodSettings &lodSettings,
+                                     rg::VertexFormat vertexFormat, rg::MeshStorage storage)
+{
+    return PendingModel(rg::ServiceLocator::Get().getThreadPool().submit(
+            [=] { return Import(path, gamma, lodSettings, vertexFormat, storage); }));
+}
+
+
+// shared through the texture cache and decoded on the thread pool; the texture holds a
+// placeholder until the render loop uploads it. Each call takes a cache reference.
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, rg::TextureUsage usage)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
+
+    return rg::ServiceLocator::Get().getTextureCache().acquire(filename, usage);
 }
 #endif
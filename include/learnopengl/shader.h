@@ -4,18 +4,45 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <rg/uniform_buffer.h>
+#include <rg/gl_extensions.h>
+#include <rg/service_locator.h>
+#include <rg/texture_type.h>
+#include <rg/uniform_registry.h>
 class Shader
 {
 public:
+    // the uniforms meshes set on every draw, see Mesh::Bind; invalid in programs without them
+    struct VertexDecodingUniforms
+    {
+        rg::UniformHandle packedVertices;
+        rg::UniformHandle quantizationOffset;
+        rg::UniformHandle quantizationScale;
+    };
+
     unsigned int ID;
+    VertexDecodingUniforms vertexDecoding;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : Shader(vertexPath, fragmentPath, std::vector<std::string>(), geometryPath)
+    {
+    }
+    // compiles every stage with '#define NAME' for each of defines, right after its #version.
+    // Without wait the program may still be compiling when this returns, see ready().
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines,
+           const char* geometryPath = nullptr, bool wait = true)
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
@@ -64,111 +91,319 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        // shared sources, such as resources/shaders/include, are pasted in before the defines
+        vertexCode = addIncludes(vertexCode, vertexPath);
+        fragmentCode = addIncludes(fragmentCode, fragmentPath);
         if(geometryPath != nullptr)
+            geometryCode = addIncludes(geometryCode, geometryPath);
+        vertexCode = addDefines(vertexCode, defines);
+        fragmentCode = addDefines(fragmentCode, defines);
+        if(geometryPath != nullptr)
+            geometryCode = addDefines(geometryCode, defines);
+        // 2. link the program from a cached binary, or compile it and cache the binary
+        rg::ProgramCache &cache = rg::ServiceLocator::Get().getProgramCache();
+        const std::string sources[] = {vertexCode, fragmentCode, geometryCode};
+        cacheKey = cache.key(sources);
+        ID = cache.load(cacheKey);
+        if (ID != 0)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            setupLinkedProgram();
+            return;
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        compileStart = std::chrono::steady_clock::now();
+        compile(vertexCode, fragmentCode, geometryPath != nullptr ? &geometryCode : nullptr);
+        if (wait)
+            finishLink();
+    }
+    // whether the program is linked. While the driver still compiles it in the background,
+    // which drivers with parallel shader compilation report without waiting, it is false;
+    // elsewhere the first call waits for the compiler.
+    // ------------------------------------------------------------------------
+    bool ready()
+    {
+        if (stages.empty())
+            return true;
+        if (rg::glExtensions().parallelShaderCompile)
+        {
+            GLint done = GL_FALSE;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+            if (done == GL_FALSE)
+                return false;
+        }
+        finishLink();
+        return true;
+    }
+    // blocks until the program is linked
+    // ------------------------------------------------------------------------
+    void wait()
+    {
+        if (!stages.empty())
+            finishLink();
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        rg::ServiceLocator::Get().getGLState().useProgram(ID);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
+    rg::UniformHandle uniform(const std::string &name) const
+    {
+        return uniforms.find(name);
+    }
+    // handle based setters skip the upload when the uniform already holds the value
+    // ------------------------------------------------------------------------
+    void set(rg::UniformHandle handle, bool value) const
+    {
+        uniforms.set(handle, (int)value);
+    }
+    void set(rg::UniformHandle handle, int value) const
+    {
+        uniforms.set(handle, value);
+    }
+    void set(rg::UniformHandle handle, float value) const
+    {
+        uniforms.set(handle, value);
+    }
+    void set(rg::UniformHandle handle, const glm::vec2 &value) const
+    {
+        uniforms.set(handle, value);
+    }
+    void set(rg::UniformHandle handle, const glm::vec3 &value) const
+    {
+        uniforms.set(handle, value);
+    }
+    void set(rg::UniformHandle handle, const glm::vec4 &value) const
+    {
+        uniforms.set(handle, value);
+    }
+    void set(rg::UniformHandle handle, const glm::mat2 &mat) const
+    {
+        uniforms.set(handle, mat);
+    }
+    void set(rg::UniformHandle handle, const glm::mat3 &mat) const
+    {
+        uniforms.set(handle, mat);
+    }
+    void set(rg::UniformHandle handle, const glm::mat4 &mat) const
+    {
+        uniforms.set(handle, mat);
+    }
+    // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        set(uniform(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        set(uniform(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        set(uniform(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        set(uniform(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
 
 private:
+    // active uniforms of the program, reflected once after linking
+    mutable rg::UniformRegistry uniforms;
+    // compiled stages not checked yet, empty once the program is linked
+    std::vector<std::pair<unsigned int, const char*>> stages;
+    std::uint64_t cacheKey = 0;
+    std::chrono::steady_clock::time_point compileStart;
+
+    // inserts a #define line for each of defines after the #version line of code
+    // ------------------------------------------------------------------------
+    // replaces every '#include "name"' line with the file name names, relative to the directory
+    // of path; a file already pasted into this stage is skipped
+    static std::string addIncludes(const std::string &code, const std::string &path)
+    {
+        std::vector<std::string> included;
+        return addIncludes(code, path, included);
+    }
+
+    static std::string addIncludes(const std::string &code, const std::string &path,
+                                   std::vector<std::string> &included)
+    {
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::istringstream lines(code);
+        std::string result;
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            std::size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                result += line + '\n';
+                continue;
+            }
+            std::size_t open = line.find('"', start);
+            std::size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_MALFORMED: " << line << std::endl;
+                continue;
+            }
+            std::string includePath = directory + line.substr(open + 1, close - open - 1);
+            if (std::find(included.begin(), included.end(), includePath) != included.end())
+                continue;
+            included.push_back(includePath);
+            std::ifstream file(includePath);
+            if (!file)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+                continue;
+            }
+            std::stringstream stream;
+            stream << file.rdbuf();
+            result += addIncludes(stream.str(), includePath, included);
+        }
+        return result;
+    }
+
+    static std::string addDefines(const std::string &code, const std::vector<std::string> &defines)
+    {
+        if (defines.empty())
+            return code;
+        std::string lines;
+        for (const std::string &define : defines)
+            lines += "#define " + define + "\n";
+        // nothing but comments may come before #version
+        std::size_t start = 0;
+        std::size_t version = code.find("#version");
+        if (version != std::string::npos)
+        {
+            std::size_t end = code.find('\n', version);
+            start = end == std::string::npos ? code.size() : end + 1;
+        }
+        std::string head = code.substr(0, start);
+        if (!head.empty() && head.back() != '\n')
+            head += '\n';
+        return head + lines + code.substr(start);
+    }
+
+    // compiles the stages and links them into ID without asking how it went, so a driver
+    // compiling in the background is not made to wait
+    // ------------------------------------------------------------------------
+    void compile(const std::string &vertexCode, const std::string &fragmentCode, const std::string *geometryCode)
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        stages.emplace_back(vertex, "VERTEX");
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        stages.emplace_back(fragment, "FRAGMENT");
+        // if geometry shader is given, compile geometry shader
+        if(geometryCode != nullptr)
+        {
+            const char * gShaderCode = geometryCode->c_str();
+            unsigned int geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+            stages.emplace_back(geometry, "GEOMETRY");
+        }
+        // shader Program
+        ID = glCreateProgram();
+        for (const auto &stage : stages)
+            glAttachShader(ID, stage.first);
+        rg::ServiceLocator::Get().getProgramCache().prepare(ID);
+        glLinkProgram(ID);
+    }
+
+    // reports compile and link errors, caches the binary and sets the program up
+    // ------------------------------------------------------------------------
+    void finishLink()
+    {
+        for (const auto &stage : stages)
+            checkCompileErrors(stage.first, stage.second);
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessery
+        for (const auto &stage : stages)
+            glDeleteShader(stage.first);
+        stages.clear();
+        rg::ServiceLocator::Get().getProgramCache().store(ID, cacheKey, std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - compileStart).count());
+        setupLinkedProgram();
+    }
+
+    void setupLinkedProgram()
+    {
+        // look up every active uniform once, the setters below only go through the table
+        uniforms.reflect(ID);
+        rg::bindUniformBlocks(ID);
+        bindTextureUnits();
+        vertexDecoding.packedVertices = uniform("packedVertices");
+        vertexDecoding.quantizationOffset = uniform("quantizationOffset");
+        vertexDecoding.quantizationScale = uniform("quantizationScale");
+    }
+
+    // points every texture_<type><N> sampler the program declares at the unit of its type
+    // and number, which is where materials bind their textures, and the shared samplers at
+    // their units
+    void bindTextureUnits()
+    {
+        use();
+        for (unsigned int type = 0; type < rg::TEXTURE_TYPE_COUNT; type++)
+        {
+            rg::TextureType textureType = static_cast<rg::TextureType>(type);
+            for (unsigned int index = 0; index < rg::MAX_TEXTURES_PER_TYPE; index++)
+                set(uniform(rg::textureSamplerName(textureType, index)), (int)rg::textureUnit(textureType, index));
+        }
+        for (const rg::SharedSampler &sampler : rg::SHARED_SAMPLERS)
+            set(uniform(sampler.name), (int)sampler.unit);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -13,8 +13,11 @@
 #include <rg/Error.h>
 #include <common.h>
 #include <glm/glm.hpp>
+#include <rg/uniform_buffer.h>
+#include <rg/uniform_registry.h>
 class Shader {
     unsigned int m_Id;
+    mutable rg::UniformRegistry m_Uniforms;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
@@ -65,6 +68,8 @@ public:
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
+        m_Uniforms.reflect(m_Id);
+        rg::bindUniformBlocks(m_Id);
     }
 
     // activate the shader
@@ -75,61 +80,75 @@ public:
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
+    rg::UniformHandle uniform(const std::string &name) const
+    {
+        return m_Uniforms.find(name);
+    }
+    template<typename T>
+    void set(rg::UniformHandle handle, const T &value) const
+    {
+        m_Uniforms.set(handle, value);
+    }
+    void set(rg::UniformHandle handle, bool value) const
+    {
+        m_Uniforms.set(handle, (int)value);
+    }
+    // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        set(uniform(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        set(uniform(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        set(uniform(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        set(uniform(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        set(uniform(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        set(uniform(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        set(uniform(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        set(uniform(name), mat);
     }
     void deleteProgram() {
         glDeleteProgram(m_Id);
@@ -0,0 +1,60 @@
+#ifndef PROJECT_BASE_BOUNDS_H
+#define PROJECT_BASE_BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace rg {
+
+    // Axis aligned box. A default constructed box is empty; extending it by a point makes
+    // it contain exactly that point.
+    struct AABB {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+        bool empty() const { return min.x > max.x; }
+
+        glm::vec3 center() const { return (min + max) * 0.5f; }
+
+        glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+        void extend(const glm::vec3 &point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        void extend(const AABB &box) {
+            min = glm::min(min, box.min);
+            max = glm::max(max, box.max);
+        }
+    };
+
+    struct BoundingSphere {
+        glm::vec3 center{0.0f};
+        float radius = 0.0f;
+    };
+
+    // Box around the transformed box: the extent picks up the absolute value of every
+    // rotation/scale term, so the result stays tight for axis aligned transforms.
+    inline AABB transform(const AABB &box, const glm::mat4 &model) {
+        glm::vec3 center = glm::vec3(model * glm::vec4(box.center(), 1.0f));
+        glm::vec3 extent = box.extent();
+        glm::vec3 worldExtent{0.0f};
+        for (int column = 0; column < 3; ++column) {
+            worldExtent += glm::abs(glm::vec3(model[column])) * extent[column];
+        }
+        return AABB{center - worldExtent, center + worldExtent};
+    }
+
+    // Non-uniform scale grows the radius by the largest axis scale.
+    inline BoundingSphere transform(const BoundingSphere &sphere, const glm::mat4 &model) {
+        float scale = std::max({glm::length(glm::vec3(model[0])),
+                                glm::length(glm::vec3(model[1])),
+                                glm::length(glm::vec3(model[2]))});
+        return BoundingSphere{glm::vec3(model * glm::vec4(sphere.center, 1.0f)), sphere.radius * scale};
+    }
+}
+
+#endif //PROJECT_BASE_BOUNDS_H
@@ -0,0 +1,50 @@
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <rg/bounds.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rg {
+
+    // View frustum as six inward facing planes (xyz normal, w distance), in world space
+    // when built from projection * view.
+    struct Frustum {
+        enum Plane { Left, Right, Bottom, Top, Near, Far };
+
+        std::array<glm::vec4, 6> planes{};
+
+        static Frustum fromMatrix(const glm::mat4 &viewProjection);
+
+        bool intersects(const AABB &box) const;
+
+        bool intersects(const BoundingSphere &sphere) const;
+    };
+
+    // World space boxes stored as separate center and extent arrays, so that the frustum
+    // test runs on four boxes per SSE instruction.
+    class AABBBatch {
+    public:
+        void clear();
+
+        // Returns the index of the box in the batch.
+        std::size_t add(const AABB &box);
+
+        std::size_t size() const { return m_count; }
+
+        // visible[i] is set to 1 when box i intersects the frustum, 0 otherwise.
+        void cull(const Frustum &frustum, std::vector<std::uint8_t> &visible) const;
+
+    private:
+        std::size_t m_count = 0;
+        // padded to a multiple of four, the padding lanes are tested but never reported
+        std::vector<float> m_centerX, m_centerY, m_centerZ;
+        std::vector<float> m_extentX, m_extentY, m_extentZ;
+    };
+}
+
+#endif //PROJECT_BASE_FRUSTUM_H
@@ -0,0 +1,39 @@
+#ifndef PROJECT_BASE_GBUFFER_H
+#define PROJECT_BASE_GBUFFER_H
+
+namespace rg {
+
+    // Render targets of the deferred path. Opaque geometry writes its surface here and a
+    // full-screen pass lights every pixel once, no matter how many layers were drawn over
+    // it. Per pixel, 16 bytes:
+    //   albedoOcclusion  RGBA8     albedo, and the share of ambient light reaching it
+    //   normal           RG16      world space normal, octahedral encoded
+    //   material         RGBA8     roughness, metallic and shininess / 256
+    //   depth            DEPTH24   positions are rebuilt from it, none are stored
+    // The targets are single sampled; the lighting pass writes its color and depth to every
+    // sample of the multisampled framebuffer, so forward passes after it test against the
+    // G-buffer depth.
+    class GBuffer {
+    public:
+        // targets of the size of the framebuffer the lighting pass draws to
+        GBuffer(unsigned int width, unsigned int height);
+        ~GBuffer();
+
+        GBuffer(const GBuffer &) = delete;
+        GBuffer &operator=(const GBuffer &) = delete;
+
+        // Binds the framebuffer for the geometry pass and clears it.
+        void bindForGeometry() const;
+
+        // Binds the targets to the G-buffer units for the lighting pass.
+        void bindTextures() const;
+
+    private:
+        enum Target { AlbedoOcclusion, Normal, Material, Depth, TARGET_COUNT };
+
+        unsigned int m_FBO = 0;
+        unsigned int m_textures[TARGET_COUNT] = {};
+    };
+}
+
+#endif //PROJECT_BASE_GBUFFER_H
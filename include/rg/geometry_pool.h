@@ -0,0 +1,95 @@
+#ifndef PROJECT_BASE_GEOMETRY_POOL_H
+#define PROJECT_BASE_GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace rg {
+
+    // Standalone meshes own their VAO and buffers, pooled ones are suballocated from the
+    // process-wide GeometryPool.
+    enum class MeshStorage {
+        Standalone,
+        Pooled
+    };
+
+    // Laid out as glMultiDrawElementsIndirect reads it from the draw indirect buffer.
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Where a mesh landed in the pool. Indices stay relative to the first vertex of the
+    // mesh, draws add baseVertex.
+    struct GeometryRange {
+        unsigned int VAO = 0;
+        int baseVertex = 0;
+        unsigned int firstIndex = 0;
+    };
+
+    // Shared vertex and index arenas, one per vertex layout and index type, each under a
+    // single VAO. Meshes drawn from the same arena never switch VAO or buffers, and runs of
+    // them can be drawn with one glMultiDrawElementsIndirect on GL 4.3 contexts.
+    //
+    // Allocations are never freed; the arenas grow by doubling and copying on the GPU.
+    class GeometryPool {
+        friend class ServiceLocator;
+    public:
+        // Points the vertex attributes of the bound VAO at the bound GL_ARRAY_BUFFER. It also
+        // identifies the vertex layout: meshes with the same function share an arena.
+        using AttributeSetup = void (*)();
+
+        struct Stats {
+            unsigned int arenas = 0;
+            std::size_t vertexBytes = 0;    // in use, not reserved
+            std::size_t indexBytes = 0;
+        };
+
+        GeometryPool(const GeometryPool &) = delete;
+        GeometryPool &operator=(const GeometryPool &) = delete;
+
+        // Copies vertexCount vertices of vertexSize bytes and indexCount indices of indexType
+        // into the matching arena.
+        GeometryRange allocate(AttributeSetup setupAttributes, const void *vertexData, std::size_t vertexCount,
+                               std::size_t vertexSize, const void *indexData, std::size_t indexCount,
+                               GLenum indexType);
+
+        // Draws commands from the bound VAO in one call. Requires glExtensions().multiDrawIndirect.
+        void multiDrawIndirect(std::span<const DrawElementsIndirectCommand> commands, GLenum indexType);
+
+        Stats stats() const;
+
+        // Deletes every GL object; call while the context is still current.
+        void release();
+
+    private:
+        struct Arena {
+            AttributeSetup setupAttributes = nullptr;
+            std::size_t vertexSize = 0;
+            GLenum indexType = GL_UNSIGNED_INT;
+            unsigned int VAO = 0;
+            unsigned int vertexBuffer = 0;
+            unsigned int indexBuffer = 0;
+            std::size_t vertexCount = 0;
+            std::size_t vertexCapacity = 0;
+            std::size_t indexCount = 0;
+            std::size_t indexCapacity = 0;
+        };
+
+        GeometryPool() = default;
+
+        Arena &findArena(AttributeSetup setupAttributes, std::size_t vertexSize, GLenum indexType);
+        void reserve(Arena &arena, std::size_t vertexCount, std::size_t indexCount);
+
+        std::vector<Arena> m_arenas;
+        unsigned int m_indirectBuffer = 0;
+    };
+}
+
+#endif //PROJECT_BASE_GEOMETRY_POOL_H
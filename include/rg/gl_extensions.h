@@ -0,0 +1,108 @@
+#ifndef PROJECT_BASE_GL_EXTENSIONS_H
+#define PROJECT_BASE_GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#include <cstring>
+
+namespace rg {
+
+    // Entry points past the GL 3.3 core that glad was generated for. They stay null unless
+    // the context is recent enough, so every use has to check the matching flag first.
+    struct GLExtensions {
+        // GL_EXT_texture_compression_s3tc, BC1 to BC3; the RGTC formats BC4 and BC5 are core
+        bool textureCompressionS3TC = false;
+
+        // GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile; programs then
+        // report GL_COMPLETION_STATUS_KHR without waiting for the compiler
+        bool parallelShaderCompile = false;
+        void (APIENTRYP maxShaderCompilerThreads)(GLuint count) = nullptr;
+
+        // GL 4.1 or GL_ARB_get_program_binary, with at least one binary format
+        bool programBinaries = false;
+        void (APIENTRYP getProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length,
+                                          GLenum *binaryFormat, void *binary) = nullptr;
+        void (APIENTRYP programBinary)(GLuint program, GLenum binaryFormat, const void *binary,
+                                       GLsizei length) = nullptr;
+        void (APIENTRYP programParameteri)(GLuint program, GLenum pname, GLint value) = nullptr;
+
+        // GL 4.3
+        bool multiDrawIndirect = false;
+        void (APIENTRYP multiDrawElementsIndirect)(GLenum mode, GLenum type, const void *indirect,
+                                                   GLsizei drawCount, GLsizei stride) = nullptr;
+    };
+
+    inline GLExtensions &glExtensions() {
+        static GLExtensions extensions;
+        return extensions;
+    }
+
+    inline bool glVersionAtLeast(int major, int minor) {
+        return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+    }
+
+    // Call once after gladLoadGLLoader, with the same loader.
+    inline void loadGLExtensions(GLADloadproc load) {
+        GLExtensions &extensions = glExtensions();
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        bool getProgramBinary = glVersionAtLeast(4, 1);
+        for (GLint i = 0; i < count; ++i) {
+            const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+            if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                extensions.textureCompressionS3TC = true;
+            else if (std::strcmp(name, "GL_ARB_get_program_binary") == 0)
+                getProgramBinary = true;
+            else if (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0)
+                extensions.maxShaderCompilerThreads =
+                        reinterpret_cast<decltype(extensions.maxShaderCompilerThreads)>(
+                                load("glMaxShaderCompilerThreadsKHR"));
+            else if (std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0 &&
+                     extensions.maxShaderCompilerThreads == nullptr)
+                extensions.maxShaderCompilerThreads =
+                        reinterpret_cast<decltype(extensions.maxShaderCompilerThreads)>(
+                                load("glMaxShaderCompilerThreadsARB"));
+        }
+        extensions.parallelShaderCompile = extensions.maxShaderCompilerThreads != nullptr;
+        if (getProgramBinary) {
+            extensions.getProgramBinary =
+                    reinterpret_cast<decltype(extensions.getProgramBinary)>(load("glGetProgramBinary"));
+            extensions.programBinary =
+                    reinterpret_cast<decltype(extensions.programBinary)>(load("glProgramBinary"));
+            extensions.programParameteri =
+                    reinterpret_cast<decltype(extensions.programParameteri)>(load("glProgramParameteri"));
+            // some drivers expose the entry points but cannot save anything
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            extensions.programBinaries = extensions.getProgramBinary != nullptr &&
+                                         extensions.programBinary != nullptr &&
+                                         extensions.programParameteri != nullptr && formats > 0;
+        }
+        if (glVersionAtLeast(4, 3)) {
+            extensions.multiDrawElementsIndirect =
+                    reinterpret_cast<decltype(extensions.multiDrawElementsIndirect)>(
+                            load("glMultiDrawElementsIndirect"));
+            extensions.multiDrawIndirect = extensions.multiDrawElementsIndirect != nullptr;
+        }
+    }
+}
+
+#endif //PROJECT_BASE_GL_EXTENSIONS_H
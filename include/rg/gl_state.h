@@ -0,0 +1,233 @@
+#ifndef PROJECT_BASE_GL_STATE_H
+#define PROJECT_BASE_GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <array>
+#include <unordered_map>
+
+namespace rg {
+
+    // Shadow of the OpenGL binding and enable state. Calls that would set a value the
+    // context already holds are dropped before they reach the driver. Everything that binds
+    // programs, VAOs, textures, uniform buffers or framebuffers, or sets the depth function,
+    // viewport or polygon offset during rendering has to go through here, otherwise the shadow
+    // goes stale; invalidate() forgets everything after foreign code ran.
+    class GLState {
+        friend class ServiceLocator;
+    public:
+        struct FrameStats {
+            unsigned int issued = 0;    // state changes that reached the driver
+            unsigned int filtered = 0;  // state changes dropped as redundant
+        };
+
+        static constexpr unsigned int MAX_TEXTURE_UNITS = 16;
+        static constexpr unsigned int MAX_UNIFORM_BUFFER_BINDINGS = 8;
+
+        void useProgram(unsigned int program) {
+            if (filter(m_program, program))
+                glUseProgram(program);
+        }
+
+        void bindVertexArray(unsigned int VAO) {
+            if (filter(m_vertexArray, VAO))
+                glBindVertexArray(VAO);
+        }
+
+        void activeTexture(unsigned int unit) {
+            if (filter(m_activeUnit, unit))
+                glActiveTexture(GL_TEXTURE0 + unit);
+        }
+
+        void bindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+            if (unit >= MAX_TEXTURE_UNITS) {
+                // not shadowed; the unit switch counts itself in activeTexture
+                activeTexture(unit);
+                ++m_stats.issued;
+                glBindTexture(target, texture);
+                return;
+            }
+            TextureBinding &binding = m_textures[unit];
+            if (binding.target == target && binding.texture == texture) {
+                ++m_stats.filtered;
+                return;
+            }
+            activeTexture(unit);
+            binding.target = target;
+            binding.texture = texture;
+            ++m_stats.issued;
+            glBindTexture(target, texture);
+        }
+
+        // Binds buffer to a uniform block binding point. Also binds it to GL_UNIFORM_BUFFER,
+        // which is not shadowed; bind that target directly before updating a buffer.
+        void bindUniformBuffer(unsigned int binding, unsigned int buffer) {
+            if (binding >= MAX_UNIFORM_BUFFER_BINDINGS) {
+                ++m_stats.issued;
+                glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+                return;
+            }
+            if (filter(m_uniformBuffers[binding], buffer))
+                glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        }
+
+        // GL_FRAMEBUFFER binds both the read and the draw framebuffer.
+        void bindFramebuffer(GLenum target, unsigned int framebuffer) {
+            bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+            bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+            if ((!read || m_readFramebuffer == framebuffer) && (!draw || m_drawFramebuffer == framebuffer)) {
+                ++m_stats.filtered;
+                return;
+            }
+            if (read)
+                m_readFramebuffer = framebuffer;
+            if (draw)
+                m_drawFramebuffer = framebuffer;
+            ++m_stats.issued;
+            glBindFramebuffer(target, framebuffer);
+        }
+
+        void setEnabled(GLenum capability, bool enabled) {
+            auto it = m_capabilities.find(capability);
+            if (it != m_capabilities.end() && it->second == enabled) {
+                ++m_stats.filtered;
+                return;
+            }
+            m_capabilities[capability] = enabled;
+            ++m_stats.issued;
+            if (enabled)
+                glEnable(capability);
+            else
+                glDisable(capability);
+        }
+
+        void enable(GLenum capability) { setEnabled(capability, true); }
+
+        void disable(GLenum capability) { setEnabled(capability, false); }
+
+        void depthFunc(GLenum func) {
+            if (filter(m_depthFunc, func))
+                glDepthFunc(func);
+        }
+
+        void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+            std::array<GLint, 4> value{x, y, width, height};
+            if (m_viewportKnown && m_viewport == value) {
+                ++m_stats.filtered;
+                return;
+            }
+            m_viewport = value;
+            m_viewportKnown = true;
+            ++m_stats.issued;
+            glViewport(x, y, width, height);
+        }
+
+        // The current viewport as x, y, width and height; asks the driver only when the shadow
+        // does not know it.
+        const std::array<GLint, 4> &viewport() {
+            if (!m_viewportKnown) {
+                glGetIntegerv(GL_VIEWPORT, m_viewport.data());
+                m_viewportKnown = true;
+            }
+            return m_viewport;
+        }
+
+        void polygonOffset(float factor, float units) {
+            if (m_polygonOffsetKnown && m_polygonOffset[0] == factor && m_polygonOffset[1] == units) {
+                ++m_stats.filtered;
+                return;
+            }
+            m_polygonOffset = {factor, units};
+            m_polygonOffsetKnown = true;
+            ++m_stats.issued;
+            glPolygonOffset(factor, units);
+        }
+
+        // Must be called when a texture is deleted, its name may be handed out again.
+        void forgetTexture(unsigned int texture) {
+            for (TextureBinding &binding : m_textures) {
+                if (binding.texture == texture)
+                    binding = TextureBinding{};
+            }
+        }
+
+        // Must be called when a uniform buffer is deleted, for the same reason.
+        void forgetUniformBuffer(unsigned int buffer) {
+            for (unsigned int &binding : m_uniformBuffers) {
+                if (binding == buffer)
+                    binding = UNKNOWN;
+            }
+        }
+
+        // Must be called when a VAO is deleted, for the same reason.
+        void forgetVertexArray(unsigned int VAO) {
+            if (m_vertexArray == VAO)
+                m_vertexArray = UNKNOWN;
+        }
+
+        // Forgets the shadowed state, the next call of every kind reaches the driver.
+        void invalidate() {
+            m_program = UNKNOWN;
+            m_vertexArray = UNKNOWN;
+            m_activeUnit = UNKNOWN;
+            m_readFramebuffer = UNKNOWN;
+            m_drawFramebuffer = UNKNOWN;
+            m_textures.fill(TextureBinding{});
+            m_uniformBuffers.fill(UNKNOWN);
+            m_capabilities.clear();
+            m_depthFunc = UNKNOWN;
+            m_viewportKnown = false;
+            m_polygonOffsetKnown = false;
+        }
+
+        const FrameStats &frameStats() const { return m_stats; }
+
+        void resetFrameStats() { m_stats = FrameStats{}; }
+
+        GLState(const GLState &) = delete;
+        GLState &operator=(const GLState &) = delete;
+    private:
+        static constexpr unsigned int UNKNOWN = 0xFFFFFFFF;
+
+        struct TextureBinding {
+            GLenum target = GL_NONE;
+            unsigned int texture = UNKNOWN;
+        };
+
+        GLState() = default;
+
+        static std::array<unsigned int, MAX_UNIFORM_BUFFER_BINDINGS> makeUnknownBindings() {
+            std::array<unsigned int, MAX_UNIFORM_BUFFER_BINDINGS> bindings;
+            bindings.fill(UNKNOWN);
+            return bindings;
+        }
+
+        // Records value as the current one; returns false when it already was.
+        bool filter(unsigned int &current, unsigned int value) {
+            if (current == value) {
+                ++m_stats.filtered;
+                return false;
+            }
+            current = value;
+            ++m_stats.issued;
+            return true;
+        }
+
+        unsigned int m_program = UNKNOWN;
+        unsigned int m_vertexArray = UNKNOWN;
+        unsigned int m_activeUnit = UNKNOWN;
+        unsigned int m_readFramebuffer = UNKNOWN;
+        unsigned int m_drawFramebuffer = UNKNOWN;
+        std::array<TextureBinding, MAX_TEXTURE_UNITS> m_textures{};
+        std::array<unsigned int, MAX_UNIFORM_BUFFER_BINDINGS> m_uniformBuffers = makeUnknownBindings();
+        std::unordered_map<GLenum, bool> m_capabilities;
+        unsigned int m_depthFunc = UNKNOWN;
+        std::array<GLint, 4> m_viewport{};
+        bool m_viewportKnown = false;
+        std::array<float, 2> m_polygonOffset{};
+        bool m_polygonOffsetKnown = false;
+        FrameStats m_stats;
+    };
+}
+
+#endif //PROJECT_BASE_GL_STATE_H
@@ -38,6 +38,10 @@ namespace rg {
 
         void processKeyCallback(GLFWwindow *window, int key, int action);
 
+        // Mouse buttons share the key table; GLFW button codes are below every key code, so
+        // getKeyState(GLFW_MOUSE_BUTTON_LEFT) reports the left button.
+        void processMouseButtonCallback(int button, int action);
+
         void processMouseMovementCallback(double xpos, double ypos);
 
         void processMouseScrollCallback(double ypos);
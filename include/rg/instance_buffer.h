@@ -0,0 +1,80 @@
+#ifndef PROJECT_BASE_INSTANCE_BUFFER_H
+#define PROJECT_BASE_INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/service_locator.h>
+
+#include <cstddef>
+#include <span>
+#include <utility>
+
+namespace rg {
+
+    // First attribute location of the per-instance model matrix. A mat4 attribute
+    // occupies four consecutive locations (5, 6, 7 and 8), one vec4 column each.
+    constexpr unsigned int INSTANCE_MATRIX_LOCATION = 5;
+
+    // Vertex buffer holding one model matrix per instance. It is attached to a VAO with
+    // an attribute divisor of 1, so every instance of an instanced draw reads the next matrix.
+    class InstanceBuffer {
+    public:
+        InstanceBuffer() {
+            glGenBuffers(1, &m_VBO);
+        }
+
+        ~InstanceBuffer() {
+            glDeleteBuffers(1, &m_VBO);
+        }
+
+        InstanceBuffer(const InstanceBuffer &) = delete;
+        InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+        // the buffer moves along, other is left without one
+        InstanceBuffer(InstanceBuffer &&other) noexcept
+            : m_VBO(std::exchange(other.m_VBO, 0)), m_capacity(std::exchange(other.m_capacity, 0)) {
+        }
+
+        InstanceBuffer &operator=(InstanceBuffer &&other) noexcept {
+            if (this != &other) {
+                glDeleteBuffers(1, &m_VBO);
+                m_VBO = std::exchange(other.m_VBO, 0);
+                m_capacity = std::exchange(other.m_capacity, 0);
+            }
+            return *this;
+        }
+
+        // Points the instance matrix attributes of VAO at this buffer, starting at byteOffset.
+        void attach(unsigned int VAO, std::size_t byteOffset = 0) const {
+            ServiceLocator::Get().getGLState().bindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+            for (unsigned int column = 0; column < 4; ++column) {
+                unsigned int location = INSTANCE_MATRIX_LOCATION + column;
+                glEnableVertexAttribArray(location);
+                glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                                      (void *) (byteOffset + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(location, 1);
+            }
+        }
+
+        // Replaces the buffer contents. The storage is orphaned on every upload so the driver
+        // never has to wait for draws that still read the previous matrices.
+        void upload(std::span<const glm::mat4> matrices) {
+            std::size_t size = matrices.size_bytes();
+            if (size > m_capacity) {
+                m_capacity = size;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+            glBufferData(GL_ARRAY_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, size, matrices.data());
+        }
+
+        unsigned int id() const { return m_VBO; }
+
+    private:
+        unsigned int m_VBO = 0;
+        std::size_t m_capacity = 0;
+    };
+}
+
+#endif //PROJECT_BASE_INSTANCE_BUFFER_H
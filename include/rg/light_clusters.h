@@ -0,0 +1,114 @@
+#ifndef PROJECT_BASE_LIGHT_CLUSTERS_H
+#define PROJECT_BASE_LIGHT_CLUSTERS_H
+
+#include <glm/glm.hpp>
+#include <rg/uniform_buffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace rg {
+
+    // A point light in the layout of the pointLights texture buffer, four RGBA32F texels.
+    struct PointLightData {
+        glm::vec3 position;
+        float radius;           // the light is faded out to nothing at this distance
+        glm::vec3 ambient;
+        float constant;
+        glm::vec3 diffuse;
+        float linear;
+        glm::vec3 specular;
+        float quadratic;
+    };
+
+    static_assert(sizeof(PointLightData) == 64);
+
+    // Distance at which the brightest channel of the light, attenuated, drops to threshold.
+    float pointLightRadius(const PointLightData &light, float threshold = 1.0f / 64.0f);
+
+    // Clustered forward lighting. The view frustum is cut into a grid of clusters, tiles of
+    // the window in x and y and slices of exponentially growing depth in z. Every frame the
+    // lights are assigned to the clusters they reach on the CPU, one worker per slice, each
+    // testing a light sphere against four cluster boxes at a time. The fragment shaders find
+    // their cluster from the window position and view depth and only loop over its lights.
+    //
+    // Three texture buffers hold the result: clusterGrid, the offset and count of the lights
+    // of every cluster; clusterLightIndices, the lists those point into; and pointLights, the
+    // lights themselves. The ClusterData uniform block tells the shaders the grid layout.
+    class LightClusters {
+    public:
+        struct Stats {
+            unsigned int lights = 0;            // submitted
+            unsigned int references = 0;        // light indices over all clusters
+            unsigned int maxPerCluster = 0;
+            // lights and references past what the texture buffers hold, and references
+            // past MAX_LIGHTS_PER_CLUSTER
+            unsigned int dropped = 0;
+            double assignMilliseconds = 0.0;
+        };
+
+        // clusters that would take more keep the first ones
+        static constexpr unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+        // the light lists hold 16-bit indices; fewer fit when the texture buffers are small
+        static constexpr std::size_t MAX_LIGHTS = 65536;
+
+        LightClusters(unsigned int gridX = 16, unsigned int gridY = 9, unsigned int gridZ = 24);
+        ~LightClusters();
+
+        LightClusters(const LightClusters &) = delete;
+        LightClusters &operator=(const LightClusters &) = delete;
+
+        // The perspective projection drawn with and the pixel size of the window it covers.
+        // The cluster bounds are only rebuilt when these change.
+        void setProjection(float fovY, float aspect, float near, float far, float width, float height);
+
+        // Assigns lights, in world space, to the clusters of view and uploads the lists.
+        void update(const glm::mat4 &view, std::span<const PointLightData> lights);
+
+        // Binds the texture buffers to their shared units.
+        void bind() const;
+
+        const Stats &stats() const { return m_stats; }
+
+    private:
+        // view space boxes of the clusters of one slice, as separate center and extent
+        // arrays padded to a multiple of four
+        struct Slice {
+            float near = 0.0f;
+            float far = 0.0f;
+            std::vector<float> centerX, centerY, centerZ;
+            std::vector<float> extentX, extentY, extentZ;
+        };
+
+        void buildSlices();
+        void assignSlice(unsigned int z);
+
+        unsigned int m_gridX, m_gridY, m_gridZ;
+        float m_fovY = 0.0f, m_aspect = 0.0f, m_near = 0.0f, m_far = 0.0f;
+        float m_width = 0.0f, m_height = 0.0f;
+        std::vector<Slice> m_slices;
+
+        // view space spheres of the lights this frame, xyz center and w radius
+        std::vector<glm::vec4> m_viewLights;
+        // per cluster MAX_LIGHTS_PER_CLUSTER slots, of which m_counts are used
+        std::vector<std::uint16_t> m_clusterLights;
+        std::vector<unsigned int> m_counts;
+        std::vector<unsigned int> m_dropped;     // per slice, summed into the stats
+        // what is uploaded: offset and count per cluster, and the lists one after the other
+        std::vector<std::uint32_t> m_grid;
+        std::vector<std::uint16_t> m_indices;
+        // what fits the texture buffers of the driver
+        std::size_t m_maxLights = 0;
+        std::size_t m_maxIndices = 0;
+
+        UniformBuffer<ClusterDataBlock> m_clusterData{CLUSTERS_BINDING};
+        ClusterDataBlock m_block{};
+        unsigned int m_buffers[3] = {};
+        unsigned int m_textures[3] = {};
+        Stats m_stats;
+    };
+}
+
+#endif //PROJECT_BASE_LIGHT_CLUSTERS_H
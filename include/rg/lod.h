@@ -0,0 +1,98 @@
+#ifndef PROJECT_BASE_LOD_H
+#define PROJECT_BASE_LOD_H
+
+#include <glm/glm.hpp>
+#include <rg/bounds.h>
+
+#include <algorithm>
+#include <array>
+#include <span>
+
+namespace rg {
+
+    // Levels of detail are index ranges into the index buffer of their mesh; every level
+    // reuses the vertices of the full detail mesh.
+    struct MeshLod {
+        unsigned int indexOffset = 0;
+        unsigned int indexCount = 0;
+        // simplification error relative to the radius of the mesh bounds
+        float error = 0.0f;
+    };
+
+    // Full detail plus up to three simplified levels.
+    constexpr unsigned int MAX_MESH_LODS = 4;
+
+    struct LodSettings {
+        // simplified levels generated below the full detail one
+        unsigned int levels = MAX_MESH_LODS - 1;
+        // fraction of the triangles of the previous level kept by the next one
+        float reduction = 0.5f;
+        // error budget relative to the mesh radius; levels stop before exceeding it
+        float maxError = 0.02f;
+        // meshes with fewer triangles are not worth simplifying
+        unsigned int minTriangles = 64;
+    };
+
+    constexpr LodSettings NO_LODS{0};
+
+    // Picks the coarsest level whose error stays below maxPixelError once projected.
+    // pixelsPerUnit is the screen size in pixels of one world unit at distance 1, that is
+    // projection[1][1] * viewportHeight / 2.
+    inline unsigned int selectLod(std::span<const MeshLod> lods, const BoundingSphere &worldSphere,
+                                  const glm::vec3 &viewPosition, float pixelsPerUnit,
+                                  float maxPixelError = 1.0f) {
+        float distance = glm::length(worldSphere.center - viewPosition) - worldSphere.radius;
+        if (distance <= 0.0f)
+            return 0;
+        float projectedRadius = worldSphere.radius * pixelsPerUnit / distance;
+        unsigned int lod = 0;
+        while (lod + 1 < lods.size() && lods[lod + 1].error * projectedRadius <= maxPixelError)
+            ++lod;
+        return lod;
+    }
+
+    // Cross-fade between the previous and the current level of one object. While a fade
+    // runs both levels are drawn with complementary dither patterns: the incoming level
+    // gets fade t, the outgoing one -t, and 0 means no dithering at all.
+    class LodTransition {
+    public:
+        struct Draw {
+            unsigned int lod = 0;
+            float fade = 0.0f;
+        };
+
+        static constexpr float FADE_TIME = 0.25f;
+
+        // Moves towards target and writes the levels to draw this frame; returns how many.
+        unsigned int update(unsigned int target, float time, std::array<Draw, 2> &draws) {
+            if (!m_started) {
+                m_started = true;
+                m_current = target;
+            } else if (target != m_current) {
+                m_previous = m_current;
+                m_current = target;
+                m_fadeStart = time;
+                m_fading = true;
+            }
+            float t = (time - m_fadeStart) / FADE_TIME;
+            if (m_fading && t < 1.0f) {
+                t = std::max(t, 1.0f / 64.0f);
+                draws[0] = Draw{m_current, t};
+                draws[1] = Draw{m_previous, -t};
+                return 2;
+            }
+            m_fading = false;
+            draws[0] = Draw{m_current, 0.0f};
+            return 1;
+        }
+
+    private:
+        bool m_started = false;
+        bool m_fading = false;
+        unsigned int m_current = 0;
+        unsigned int m_previous = 0;
+        float m_fadeStart = 0.0f;
+    };
+}
+
+#endif //PROJECT_BASE_LOD_H
@@ -0,0 +1,72 @@
+#ifndef PROJECT_BASE_MATERIAL_H
+#define PROJECT_BASE_MATERIAL_H
+
+#include <rg/shader_library.h>
+#include <rg/shader_variants.h>
+#include <rg/texture_type.h>
+#include <rg/uniform_buffer.h>
+
+#include <cstdint>
+#include <vector>
+
+class Shader;
+struct Texture;
+
+namespace rg {
+
+    // How meshes are drawn: a program shared with every material of the same shaders, the
+    // textures, and the parameters of the MaterialData uniform block. The texture units are
+    // worked out once, when the material is made, and the parameters sit in a buffer of the
+    // material's own, so binding one is a few filtered binds and no uniform uploads. Meshes
+    // with the same material draw with the same state, the render queue batches on it.
+    class Material {
+    public:
+        // A lighting material. The variant drawn has the features of the frame and the ones
+        // the textures call for, a second diffuse map or a normal map.
+        Material(ShaderVariants &variants, const std::vector<Texture> &textures,
+                 const MaterialBlock &parameters = {});
+
+        // A material drawn with one program of library.
+        Material(ShaderLibrary &library, ShaderLibrary::Handle program, const std::vector<Texture> &textures,
+                 const MaterialBlock &parameters = {});
+
+        Material(const Material &) = delete;
+        Material &operator=(const Material &) = delete;
+
+        // The program to draw with, null while it compiles. frameFeatures only matter to
+        // lighting materials.
+        Shader *shader(std::uint32_t frameFeatures = 0) const;
+
+        // Binds the textures to the units of their types and the parameters to
+        // MATERIAL_BINDING; the program's samplers already point at those units.
+        void bind() const;
+
+        void setParameters(const MaterialBlock &parameters);
+
+        const MaterialBlock &parameters() const { return m_parameters.data(); }
+
+        // Whether the shaders have a GBUFFER variant, which deferred shading draws opaque
+        // meshes with; the others are drawn forward after the lighting pass.
+        bool deferred() const;
+
+        // ShaderFeature bits the textures call for
+        std::uint32_t features() const { return m_features; }
+
+    private:
+        struct Binding {
+            unsigned int unit;
+            unsigned int texture;
+        };
+
+        void setTextures(const std::vector<Texture> &textures);
+
+        ShaderVariants *m_variants = nullptr;
+        ShaderLibrary *m_library = nullptr;
+        ShaderLibrary::Handle m_program = 0;
+        std::uint32_t m_features = 0;
+        std::vector<Binding> m_bindings;
+        UniformBuffer<MaterialBlock> m_parameters{MATERIAL_BINDING, GL_STATIC_DRAW};
+    };
+}
+
+#endif //PROJECT_BASE_MATERIAL_H
@@ -0,0 +1,71 @@
+#ifndef PROJECT_BASE_MESH_OPTIMIZER_H
+#define PROJECT_BASE_MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace rg {
+
+    // Marks vertices that were never referenced in a remap table.
+    constexpr unsigned int UNUSED_VERTEX = ~0u;
+
+    // Fills remap[i] with the new index of vertex i, where vertices with identical bytes
+    // share an index. Returns the number of unique vertices.
+    std::size_t generateVertexRemap(std::span<unsigned int> remap, const void *vertices,
+                                    std::size_t vertexCount, std::size_t vertexSize);
+
+    // Fills remap[i] with the new index of vertex i so that vertices appear in the order the
+    // indices first use them; unreferenced vertices get UNUSED_VERTEX. Returns the number
+    // of referenced vertices.
+    std::size_t generateFetchRemap(std::span<unsigned int> remap, std::span<const unsigned int> indices);
+
+    void remapIndices(std::span<unsigned int> indices, std::span<const unsigned int> remap);
+
+    template<typename Vertex>
+    std::vector<Vertex> remapVertices(const std::vector<Vertex> &vertices, std::span<const unsigned int> remap,
+                                      std::size_t uniqueCount) {
+        std::vector<Vertex> result(uniqueCount);
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            if (remap[i] != UNUSED_VERTEX)
+                result[remap[i]] = vertices[i];
+        }
+        return result;
+    }
+
+    // Reorders triangles so that consecutive ones share vertices, using Forsyth's linear
+    // speed vertex cache optimization.
+    void optimizeVertexCache(std::span<unsigned int> indices, std::size_t vertexCount);
+
+    // Splits a cache optimized triangle list into clusters at cache flushes and sorts the
+    // clusters so that outward facing ones come first, which lets early depth testing
+    // reject more of the rest. Clusters are split further while their ACMR stays within
+    // threshold times that of the whole cluster, trading cache efficiency for finer sorting.
+    void optimizeOverdraw(std::span<unsigned int> indices, std::span<const glm::vec3> positions,
+                          float threshold = 1.05f);
+
+    // Average cache miss ratio: vertex shader invocations per triangle with a FIFO
+    // post-transform cache of cacheSize entries. 0.5 is the ideal for large grids, 3 the worst.
+    float computeACMR(std::span<const unsigned int> indices, std::size_t vertexCount,
+                      unsigned int cacheSize = 16);
+
+    // Totals over every mesh optimized so far, for the stats window. The ACMRs are averaged
+    // over the triangles of all meshes.
+    struct MeshOptimizerStats {
+        unsigned int meshes = 0;
+        std::size_t importedVertices = 0;
+        std::size_t optimizedVertices = 0;
+        float importedACMR = 0.0f;
+        float optimizedACMR = 0.0f;
+    };
+
+    // Adds one optimized mesh to the totals; safe to call from the loader threads.
+    void recordMeshOptimization(std::size_t importedVertices, std::size_t optimizedVertices,
+                                float importedACMR, float optimizedACMR, std::size_t triangleCount);
+
+    MeshOptimizerStats meshOptimizerStats();
+}
+
+#endif //PROJECT_BASE_MESH_OPTIMIZER_H
@@ -0,0 +1,25 @@
+#ifndef PROJECT_BASE_MESH_SIMPLIFIER_H
+#define PROJECT_BASE_MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace rg {
+
+    // Quadric error edge collapse over an indexed triangle list. Vertices are only moved
+    // onto other existing vertices, so the result indexes the same vertex buffer. Vertices
+    // on open borders, which includes the splits along UV and normal seams, never move.
+    //
+    // Collapses stop at targetIndexCount or when the next one would exceed targetError,
+    // given relative to the radius of the mesh bounds. resultError receives the relative
+    // error of the returned mesh.
+    std::vector<unsigned int> simplifyMesh(std::span<const glm::vec3> positions,
+                                           std::span<const unsigned int> indices,
+                                           std::size_t targetIndexCount, float targetError,
+                                           float &resultError);
+}
+
+#endif //PROJECT_BASE_MESH_SIMPLIFIER_H
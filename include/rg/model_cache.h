@@ -0,0 +1,105 @@
+#ifndef PROJECT_BASE_MODEL_CACHE_H
+#define PROJECT_BASE_MODEL_CACHE_H
+
+#include <rg/bounds.h>
+#include <rg/lod.h>
+#include <rg/vertex_format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace rg {
+
+    // Read only memory mapping of a whole file.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::string &path);
+        ~MappedFile();
+
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool valid() const { return m_data != nullptr; }
+        const std::byte *data() const { return static_cast<const std::byte *>(m_data); }
+        std::size_t size() const { return m_size; }
+
+    private:
+        void *m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+
+    // 64-bit FNV-1a; pass the previous result as hash to continue over several buffers.
+    std::uint64_t hashBytes(const void *data, std::size_t size, std::uint64_t hash = 0xcbf29ce484222325ull);
+
+    // Hash of the contents of a file, or 0 when it cannot be read.
+    std::uint64_t hashFile(const std::string &path, std::uint64_t hash = 0xcbf29ce484222325ull);
+
+    // Everything about a cooked mesh except its variable length data, stored as is.
+    struct CookedMeshHeader {
+        std::uint32_t vertexFormat = 0;
+        std::uint32_t vertexCount = 0;
+        std::uint32_t vertexSize = 0;
+        std::uint32_t indexType = 0;
+        std::uint32_t indexCount = 0;
+        std::uint32_t lodCount = 0;
+        std::uint32_t textureCount = 0;
+        std::uint32_t reserved = 0;
+        MeshLod lods[MAX_MESH_LODS];
+        AABB bounds;
+        BoundingSphere sphere;
+        VertexQuantization quantization;
+    };
+    static_assert(std::is_trivially_copyable_v<CookedMeshHeader>);
+
+    struct CookedTexture {
+        // the sampler name of its rg::TextureType, see textureTypeName
+        std::string type;
+        // relative to the directory of the model, as the material names it
+        std::string path;
+    };
+
+    // The vertex and index data are in the layout they are uploaded in. For meshes read
+    // from a cache they point into its mapping.
+    struct CookedMesh {
+        CookedMeshHeader header;
+        std::vector<CookedTexture> textures;
+        std::span<const std::byte> vertexData;
+        std::span<const std::byte> indexData;
+    };
+
+    // Binary cache of an imported model, written next to the source file. It holds the
+    // meshes after optimization and level of detail generation, so loading one is a
+    // mapping and an upload. A cache is only used when its version, the hash of its
+    // source files and the hash of the import settings all match.
+    class ModelCache {
+    public:
+        static constexpr std::uint32_t VERSION = 2;
+
+        // Maps path and reads the mesh table; false when the cache is missing, stale or
+        // truncated.
+        bool open(const std::string &path, std::uint64_t sourceHash, std::uint64_t settingsHash);
+
+        const std::vector<CookedMesh> &meshes() const { return m_meshes; }
+
+        // Unmaps the file; the meshes point into it, so only once they are uploaded.
+        void close();
+
+        // Writes to a temporary file first and renames it over path, so a crash never
+        // leaves a half written cache behind.
+        static bool write(const std::string &path, std::uint64_t sourceHash, std::uint64_t settingsHash,
+                          std::span<const CookedMesh> meshes);
+
+    private:
+        MappedFile m_file;
+        std::vector<CookedMesh> m_meshes;
+    };
+}
+
+#endif //PROJECT_BASE_MODEL_CACHE_H
@@ -0,0 +1,60 @@
+#ifndef PROJECT_BASE_PROGRAM_CACHE_H
+#define PROJECT_BASE_PROGRAM_CACHE_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace rg {
+
+    // Linked programs saved with glGetProgramBinary, one file per program in directory,
+    // named after its key. The key hashes the shader sources as compiled, defines included,
+    // and the GL vendor, renderer and version strings, so a driver update misses rather
+    // than handing the new driver a binary it would reject. Binaries it rejects anyway are
+    // compiled again and replaced.
+    class ProgramCache {
+        friend class ServiceLocator;
+    public:
+        struct Stats {
+            unsigned int loaded = 0;        // warm: linked from a binary
+            unsigned int compiled = 0;      // cold: compiled from the sources
+            unsigned int rejected = 0;      // of the compiled ones, had a binary the driver refused
+            double loadMilliseconds = 0.0;
+            double compileMilliseconds = 0.0;
+        };
+
+        ProgramCache(const ProgramCache &) = delete;
+        ProgramCache &operator=(const ProgramCache &) = delete;
+
+        // Off without program binary support in the driver; everything is compiled then.
+        bool available() const;
+
+        // Key of the program linked from sources, one per stage in order.
+        std::uint64_t key(std::span<const std::string> sources) const;
+
+        // A new program linked from the binary stored under key, 0 on a miss.
+        unsigned int load(std::uint64_t key);
+
+        // Call on a program compiled from sources before linking it, so the driver keeps
+        // what store needs.
+        void prepare(unsigned int program);
+
+        // Saves a linked program under key. milliseconds is what compiling and linking it
+        // took, counted as a cold start.
+        void store(unsigned int program, std::uint64_t key, double milliseconds);
+
+        const Stats &stats() const { return m_stats; }
+
+        std::string directory = "resources/shaders/cache";
+        bool enabled = true;
+
+    private:
+        ProgramCache() = default;
+
+        std::string pathOf(std::uint64_t key) const;
+
+        Stats m_stats;
+    };
+}
+
+#endif //PROJECT_BASE_PROGRAM_CACHE_H
@@ -0,0 +1,129 @@
+#ifndef PROJECT_BASE_RENDER_QUEUE_H
+#define PROJECT_BASE_RENDER_QUEUE_H
+
+#include <glm/glm.hpp>
+#include <rg/frustum.h>
+#include <rg/geometry_pool.h>
+#include <rg/instance_buffer.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Shader;
+class Mesh;
+
+namespace rg {
+    class Material;
+}
+
+namespace rg {
+
+    // Passes are drawn in this order. Opaque packets are sorted by state and then front to
+    // back, transparent ones back to front so that blending composes correctly.
+    enum class RenderPass : std::uint8_t {
+        Opaque = 0,
+        Transparent = 1,
+    };
+
+    // Collects the draws of a frame, drops the ones outside the view frustum, sorts the rest
+    // by a 64-bit key and merges consecutive packets with the same shader and mesh into one
+    // instanced draw.
+    //
+    // Key layout, most significant bits first:
+    //   opaque:      pass:2 | shader:10 | material:14 | mesh:12 | lod:2 | depth:24
+    //   transparent: pass:2 | ~depth:24 | shader:10 | material:14 | mesh:12 | lod:2
+    //
+    // The material is the one of the mesh, see Mesh::material.
+    //
+    // The per-instance model matrices of the whole frame go into one instance buffer; every
+    // batch points the instance attributes of its VAO at its own range of that buffer.
+    //
+    // On GL 4.3 contexts consecutive batches that differ only in level of detail, or in
+    // mesh when the meshes share a geometry pool arena and their vertex quantization, are
+    // issued as one multi draw indirect; baseInstance then selects their range of the
+    // instance buffer. The quantization is a uniform, set once per draw, and packed meshes
+    // are quantized to their own bounds, so in practice only the levels of one packed mesh
+    // and meshes with float vertices merge; quantizationSplits counts the rest.
+    class RenderQueue {
+    public:
+        struct FrameStats {
+            unsigned int packets = 0;   // submitted draw packets
+            unsigned int visible = 0;   // packets that passed frustum culling
+            unsigned int culled = 0;    // packets outside the view frustum
+            unsigned int batches = 0;   // draw calls issued after merging
+            unsigned int multiDraws = 0;  // batches drawn with one glMultiDrawElementsIndirect
+            unsigned int quantizationSplits = 0;  // multi draws ended by a different quantization
+            unsigned int triangles = 0; // triangles of all drawn instances
+
+            // sums the stats of queues flushed in the same frame
+            FrameStats &operator+=(const FrameStats &other) {
+                packets += other.packets;
+                visible += other.visible;
+                culled += other.culled;
+                batches += other.batches;
+                multiDraws += other.multiDraws;
+                quantizationSplits += other.quantizationSplits;
+                triangles += other.triangles;
+                return *this;
+            }
+        };
+
+        // Starts a new frame. Packet depth is measured along the view direction of view,
+        // packets are culled against the frustum of projection * view.
+        void begin(const glm::mat4 &view, const glm::mat4 &projection);
+
+        // The mesh bounds are moved into world space with model for culling and depth sorting.
+        // fade is the dithered LOD cross-fade value, see LodTransition; shaders read it from
+        // the otherwise unused element [0][3] of the instance matrix.
+        void submit(RenderPass pass, Shader &shader, Mesh &mesh, const glm::mat4 &model,
+                    unsigned int lod = 0, float fade = 0.0f);
+
+        // Culls and sorts the packets, uploads the instance matrices and issues the draws.
+        void flush();
+
+        const FrameStats &frameStats() const { return m_stats; }
+
+    private:
+        struct Packet {
+            Shader *shader;
+            Mesh *mesh;
+            unsigned int lod;
+            glm::mat4 model;
+        };
+
+        int passOf(std::size_t position) const;
+        std::size_t runEnd(std::size_t position) const;
+        static bool sharesDrawState(const Mesh &mesh, const Mesh &other);
+        static bool sharesQuantization(const Mesh &mesh, const Mesh &other);
+        std::uint64_t shaderId(const Shader &shader);
+        std::uint64_t materialId(const Material *material);
+        std::uint64_t meshId(const Mesh &mesh);
+        void cullPackets();
+        void sortKeys();
+        void setPassState(RenderPass pass);
+
+        glm::mat4 m_view{1.0f};
+        Frustum m_frustum;
+        std::vector<Packet> m_packets;
+        std::vector<std::uint64_t> m_keys;
+        AABBBatch m_bounds;
+        std::vector<std::uint8_t> m_visible;
+        std::vector<std::uint32_t> m_order;
+        // scratch buffers of the radix sort, kept to avoid reallocating every frame
+        std::vector<std::uint64_t> m_sortKeys;
+        std::vector<std::uint64_t> m_sortScratch;
+        std::vector<std::uint32_t> m_sortOrder;
+        std::vector<glm::mat4> m_instances;
+        std::vector<DrawElementsIndirectCommand> m_commands;
+        InstanceBuffer m_instanceBuffer;
+
+        std::unordered_map<unsigned int, std::uint64_t> m_shaderIds;
+        std::unordered_map<const Material *, std::uint64_t> m_materialIds;
+        std::unordered_map<const Mesh *, std::uint64_t> m_meshIds;
+
+        FrameStats m_stats;
+    };
+}
+
+#endif //PROJECT_BASE_RENDER_QUEUE_H
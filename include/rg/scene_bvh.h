@@ -0,0 +1,68 @@
+#ifndef PROJECT_BASE_SCENE_BVH_H
+#define PROJECT_BASE_SCENE_BVH_H
+
+#include <glm/glm.hpp>
+#include <rg/bounds.h>
+#include <rg/frustum.h>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace rg {
+
+    struct Ray {
+        glm::vec3 origin{0.0f};
+        glm::vec3 direction{0.0f, 0.0f, -1.0f};
+    };
+
+    // Bounding volume hierarchy over the world space bounds of scene objects. Objects are
+    // identified by their index in the span passed to build().
+    //
+    // Nodes are stored in depth first order: the left child of an internal node directly
+    // follows it and the right child is referenced by index. Every node covers a contiguous
+    // range of the object order, so a subtree that is entirely visible is emitted without
+    // visiting it.
+    class SceneBVH {
+    public:
+        struct Node {
+            AABB bounds;
+            std::uint32_t first = 0;    // first entry of the subtree in the object order
+            std::uint32_t count = 0;    // number of objects in the subtree
+            std::uint32_t right = 0;    // index of the right child, 0 for leaves
+
+            bool leaf() const { return right == 0; }
+        };
+
+        static constexpr std::uint32_t MAX_LEAF_SIZE = 4;
+
+        // Builds the tree top down with the surface area heuristic, binning the object
+        // centroids along the longest axis of their bounds.
+        void build(std::span<const AABB> objectBounds);
+
+        // Recomputes the node bounds bottom up after objects moved. The topology stays the
+        // same, so the tree degrades when objects move far; rebuild it then.
+        void refit(std::span<const AABB> objectBounds);
+
+        // Appends the objects whose leaf intersects the frustum. The result is conservative:
+        // objects of a leaf that straddles a plane are all reported.
+        void cull(const Frustum &frustum, std::vector<std::uint32_t> &visibleObjects) const;
+
+        // Nearest object whose bounds the ray enters, or -1. distance is the ray parameter
+        // of the entry point.
+        int raycast(const Ray &ray, std::span<const AABB> objectBounds, float &distance) const;
+
+        bool empty() const { return m_nodes.empty(); }
+
+        const std::vector<Node> &nodes() const { return m_nodes; }
+
+    private:
+        std::uint32_t buildNode(std::span<const AABB> objectBounds, std::vector<glm::vec3> &centroids,
+                                std::uint32_t first, std::uint32_t count);
+
+        std::vector<Node> m_nodes;
+        std::vector<std::uint32_t> m_objects;
+    };
+}
+
+#endif //PROJECT_BASE_SCENE_BVH_H
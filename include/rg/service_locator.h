@@ -9,6 +9,12 @@
 #include <rg/process_controller.h>
 #include <rg/entity_controller.h>
 #include <rg/event_controller.h>
+#include <rg/gl_state.h>
+#include <rg/geometry_pool.h>
+#include <rg/program_cache.h>
+#include <rg/texture_cache.h>
+#include <rg/texture_loader.h>
+#include <rg/thread_pool.h>
 namespace rg {
     class ServiceLocator {
     public:
@@ -16,6 +22,12 @@ namespace rg {
         ProcessController& getProcessController() { return m_ProcessController; }
         EntityController& getEntityController()  { return m_EntityController; }
         EventController& getEventController() { return m_EventController; }
+        GLState& getGLState() { return m_GLState; }
+        GeometryPool& getGeometryPool() { return m_GeometryPool; }
+        ProgramCache& getProgramCache() { return m_ProgramCache; }
+        TextureLoader& getTextureLoader() { return m_TextureLoader; }
+        TextureCache& getTextureCache() { return m_TextureCache; }
+        ThreadPool& getThreadPool() { return m_ThreadPool; }
         static ServiceLocator& Get() {
             static ServiceLocator serviceLocator;
             return  serviceLocator;
@@ -26,6 +38,13 @@ namespace rg {
         ProcessController m_ProcessController;
         EntityController m_EntityController;
         EventController m_EventController;
+        GLState m_GLState;
+        GeometryPool m_GeometryPool;
+        ProgramCache m_ProgramCache;
+        TextureLoader m_TextureLoader;
+        TextureCache m_TextureCache;
+        // declared last so its workers are joined before anything they use goes away
+        ThreadPool m_ThreadPool;
     };
 
 }
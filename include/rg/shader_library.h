@@ -0,0 +1,56 @@
+#ifndef PROJECT_BASE_SHADER_LIBRARY_H
+#define PROJECT_BASE_SHADER_LIBRARY_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Shader;
+
+namespace rg {
+
+    // Compiles programs in the background. add hands every program to the driver at once
+    // and returns a handle; update polls the ones still compiling once a frame, and get
+    // resolves a handle to its program once that is linked. Draws with a program that is
+    // not ready are skipped by the caller, so loading goes on meanwhile.
+    //
+    // Drivers with GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile compile
+    // on their own threads and answer the polls without waiting. Elsewhere the compile
+    // overlaps whatever the CPU does until the first poll, which then waits for it.
+    class ShaderLibrary {
+    public:
+        using Handle = std::uint32_t;
+
+        ShaderLibrary();
+        ~ShaderLibrary();
+
+        ShaderLibrary(const ShaderLibrary &) = delete;
+        ShaderLibrary &operator=(const ShaderLibrary &) = delete;
+
+        // defines are compiled in as '#define NAME' lines
+        Handle add(const std::string &vertexPath, const std::string &fragmentPath,
+                   const std::vector<std::string> &defines = {});
+
+        // Finishes the programs the driver is done with, returns how many are still
+        // compiling. Logs the startup times when the last one finishes.
+        unsigned int update();
+
+        // The program of handle, null while it compiles.
+        Shader *get(Handle handle) const;
+
+        // Waits for every program.
+        void finish();
+
+        unsigned int pending() const { return static_cast<unsigned int>(m_pending.size()); }
+
+    private:
+        std::vector<std::unique_ptr<Shader>> m_shaders;
+        std::vector<bool> m_ready;
+        std::vector<Handle> m_pending;
+        std::chrono::steady_clock::time_point m_firstAdd;
+    };
+}
+
+#endif //PROJECT_BASE_SHADER_LIBRARY_H
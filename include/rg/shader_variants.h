@@ -0,0 +1,87 @@
+#ifndef PROJECT_BASE_SHADER_VARIANTS_H
+#define PROJECT_BASE_SHADER_VARIANTS_H
+
+#include <learnopengl/shader.h>
+#include <rg/shader_library.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+    // Feature bits of the lighting shaders. A variant is compiled with #define NAME for
+    // every bit it has, so switched off features cost the fragment shader nothing.
+    struct ShaderFeature {
+        static constexpr std::uint32_t Blinn = 1u << 0;         // BLINN: Blinn-Phong, Phong without
+        static constexpr std::uint32_t PointLight = 1u << 1;    // POINT_LIGHT
+        static constexpr std::uint32_t Diffuse2 = 1u << 2;      // DIFFUSE2: a second diffuse map
+        static constexpr std::uint32_t NormalMap = 1u << 3;     // NORMAL_MAP: texture_normal1
+        // deferred shading: write the surface to the G-buffer instead of lighting it
+        static constexpr std::uint32_t GBuffer = 1u << 4;       // GBUFFER
+        // deferred shading: light the surface read back from the G-buffer
+        static constexpr std::uint32_t DeferredLighting = 1u << 5;  // DEFERRED_LIGHTING
+        static constexpr std::uint32_t Shadows = 1u << 6;       // SHADOWS: of the directional light
+        static constexpr unsigned int COUNT = 7;
+        static constexpr std::uint32_t ALL = (1u << COUNT) - 1;
+    };
+
+    inline constexpr const char *SHADER_FEATURE_NAMES[ShaderFeature::COUNT] = {
+            "BLINN", "POINT_LIGHT", "DIFFUSE2", "NORMAL_MAP", "GBUFFER", "DEFERRED_LIGHTING",
+            "SHADOWS"
+    };
+
+    // The programs built from one pair of sources, one per feature set in use. A variant is
+    // added to the shader library the first time it is asked for, and through the program
+    // cache only the first run pays for compiling it. Features outside supported are
+    // dropped before a variant is picked, so sources that ignore them get no copies.
+    class ShaderVariants {
+    public:
+        ShaderVariants(ShaderLibrary &library, std::string vertexPath, std::string fragmentPath,
+                       std::uint32_t supported = ShaderFeature::ALL)
+                : m_library(library), m_vertexPath(std::move(vertexPath)),
+                  m_fragmentPath(std::move(fragmentPath)), m_supported(supported) {}
+
+        ShaderVariants(const ShaderVariants &) = delete;
+        ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+        // The variant with the supported ones of features, null while it compiles. The
+        // program stays at the same address, the render queue keeps pointers to it.
+        Shader *get(std::uint32_t features) {
+            features &= m_supported;
+            auto found = m_variants.find(features);
+            if (found != m_variants.end())
+                return m_library.get(found->second);
+            std::vector<std::string> defines;
+            for (unsigned int bit = 0; bit < ShaderFeature::COUNT; ++bit) {
+                if (features & (1u << bit))
+                    defines.emplace_back(SHADER_FEATURE_NAMES[bit]);
+            }
+            m_variants.emplace(features, m_library.add(m_vertexPath, m_fragmentPath, defines));
+            return nullptr;
+        }
+
+        bool supports(std::uint32_t features) const {
+            return (m_supported & features) == features;
+        }
+
+        // Calls f on every variant ready so far, to keep their common uniforms in step.
+        void forEach(const std::function<void(Shader &)> &f) {
+            for (auto &variant : m_variants) {
+                if (Shader *shader = m_library.get(variant.second))
+                    f(*shader);
+            }
+        }
+
+    private:
+        ShaderLibrary &m_library;
+        std::string m_vertexPath;
+        std::string m_fragmentPath;
+        std::uint32_t m_supported;
+        std::unordered_map<std::uint32_t, ShaderLibrary::Handle> m_variants;
+    };
+}
+
+#endif //PROJECT_BASE_SHADER_VARIANTS_H
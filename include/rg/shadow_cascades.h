@@ -0,0 +1,115 @@
+#ifndef PROJECT_BASE_SHADOW_CASCADES_H
+#define PROJECT_BASE_SHADOW_CASCADES_H
+
+#include <glm/glm.hpp>
+#include <rg/uniform_buffer.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace rg {
+
+    // Whether and how an object is drawn into the shadow maps.
+    enum class ShadowCaster : std::uint8_t {
+        None,
+        Static,     // drawn into the cached layers, see ShadowCascades
+        Dynamic,    // drawn every frame over a copy of them
+    };
+
+    // Cascaded shadow maps of the directional light, one layer of a texture array per
+    // cascade. The view frustum up to the shadow distance is split into slices, nearer ones
+    // covering less ground at the same resolution. A cascade covers the bounding sphere of
+    // its slice, which keeps its size as the camera turns, and its center moves in steps of
+    // CACHE_SNAP_TEXELS texels of light space: whole texels keep edges from shimmering, and
+    // the coarser steps leave the cascade in place while the camera moves a little. It is
+    // one step larger than the sphere so the slice stays covered between steps.
+    //
+    // Static casters are drawn into a cached layer per cascade, redrawn only when the
+    // cascade moves, the light turns or a static caster changes. Every frame the cache is
+    // copied into the layer the shaders sample and the dynamic casters are drawn over it.
+    //
+    // Casters between the light and a cascade are flattened onto its near plane by depth
+    // clamping, so the depth range only has to span the sphere.
+    class ShadowCascades {
+    public:
+        struct Cascade {
+            glm::mat4 view;             // light view
+            glm::mat4 projection;
+            glm::mat4 viewProjection;   // world to shadow map clip space
+            // projection with the near plane pulled back towards the light, for culling
+            // casters; the shadow map pancakes them
+            glm::mat4 cullProjection;
+        };
+
+        struct Stats {
+            unsigned int cascades = 0;
+            unsigned int cacheHits = 0;     // static layers reused, since the start
+            unsigned int cacheMisses = 0;   // static layers redrawn
+            double gpuMilliseconds = 0.0;   // shadow passes of a few frames ago, timed on the GPU
+        };
+
+        static constexpr unsigned int CACHE_SNAP_TEXELS = 64;
+        static constexpr unsigned int MIN_CASCADES = 2;
+
+        explicit ShadowCascades(unsigned int size = 2048);
+        ~ShadowCascades();
+
+        ShadowCascades(const ShadowCascades &) = delete;
+        ShadowCascades &operator=(const ShadowCascades &) = delete;
+
+        // Clamped to MIN_CASCADES to MAX_SHADOW_CASCADES.
+        void setCascadeCount(unsigned int count);
+
+        // Fits the cascades to the camera and uploads the ShadowData block. staticVersion
+        // has to change whenever a static caster does.
+        void update(const glm::mat4 &cameraView, float fovY, float aspect, float near, float shadowDistance,
+                    const glm::vec3 &lightDirection, std::uint64_t staticVersion);
+
+        // Draws the shadow maps. drawCasters draws the casters of one kind with the matrices
+        // of a cascade; it is called for the static ones only when a cached layer is stale.
+        void render(const std::function<void(const Cascade &, ShadowCaster)> &drawCasters);
+
+        // Binds the shadow maps to their shared unit.
+        void bind() const;
+
+        const Stats &stats() const { return m_stats; }
+
+        // receivers are pushed this many texels of their cascade along the normal
+        float normalOffsetTexels = 1.5f;
+        // subtracted from the receiver depth, in shadow map depth units
+        float depthBias = 0.0005f;
+
+    private:
+        struct CacheState {
+            glm::mat4 viewProjection{0.0f};
+            std::uint64_t staticVersion = 0;
+            bool valid = false;
+        };
+
+        void readTimer();
+
+        unsigned int m_size;
+        unsigned int m_count = 3;
+        Cascade m_cascades[MAX_SHADOW_CASCADES];
+        CacheState m_cache[MAX_SHADOW_CASCADES];
+
+        // depth texture arrays: the static casters, and what the shaders sample
+        unsigned int m_cacheTexture = 0;
+        unsigned int m_mapTexture = 0;
+        // one framebuffer per layer of each
+        unsigned int m_cacheFBOs[MAX_SHADOW_CASCADES] = {};
+        unsigned int m_mapFBOs[MAX_SHADOW_CASCADES] = {};
+
+        // GL_TIME_ELAPSED queries, read a few frames later so nothing waits for the GPU
+        static constexpr unsigned int TIMER_QUERIES = 3;
+        unsigned int m_queries[TIMER_QUERIES] = {};
+        bool m_queryIssued[TIMER_QUERIES] = {};
+        unsigned int m_nextQuery = 0;
+
+        UniformBuffer<ShadowDataBlock> m_shadowData{SHADOWS_BINDING};
+        ShadowDataBlock m_block{};
+        Stats m_stats;
+    };
+}
+
+#endif //PROJECT_BASE_SHADOW_CASCADES_H
@@ -0,0 +1,68 @@
+#ifndef PROJECT_BASE_TEXTURE_CACHE_H
+#define PROJECT_BASE_TEXTURE_CACHE_H
+
+#include <rg/texture_loader.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+    // Process-wide set of loaded textures shared by every model and direct load. Textures
+    // are found by canonical path, and with matchContents by the hash of the file contents,
+    // which also catches byte-identical files under different names. Each acquire takes a
+    // reference; the texture is deleted when the last one is released.
+    class TextureCache {
+        friend class ServiceLocator;
+    public:
+        struct Stats {
+            unsigned int textures = 0;
+            unsigned int references = 0;
+            unsigned int hits = 0;
+            unsigned int contentHits = 0;   // hits on a different path with the same contents
+            unsigned int misses = 0;
+            std::size_t residentBytes = 0;  // of the uploaded textures
+        };
+
+        TextureCache(const TextureCache &) = delete;
+        TextureCache &operator=(const TextureCache &) = delete;
+
+        // The texture at path, started through the texture loader on a miss. usage and
+        // clampTransparent are part of the key, the same image may be loaded several ways.
+        unsigned int acquire(const std::string &path, TextureUsage usage = TextureUsage::Color,
+                             bool clampTransparent = false);
+
+        // The texture packing channels, see TextureLoader::loadPacked. Found by the
+        // canonical paths and default values only.
+        unsigned int acquirePacked(const std::vector<ChannelSource> &channels);
+
+        // Drops one reference taken by acquire or acquirePacked.
+        void release(unsigned int texture);
+
+        Stats stats() const;
+
+        // Hashes files that miss by path. Off by default, it reads the whole file on the
+        // calling thread, which is the GL thread for every miss.
+        bool matchContents = false;
+
+    private:
+        struct Entry {
+            unsigned int references = 0;
+            std::uint64_t contentKey = 0;
+        };
+
+        TextureCache() = default;
+
+        std::unordered_map<std::string, unsigned int> m_byPath;
+        std::unordered_map<std::uint64_t, unsigned int> m_byContent;
+        std::unordered_map<unsigned int, Entry> m_entries;
+        unsigned int m_hits = 0;
+        unsigned int m_contentHits = 0;
+        unsigned int m_misses = 0;
+    };
+}
+
+#endif //PROJECT_BASE_TEXTURE_CACHE_H
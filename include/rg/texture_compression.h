@@ -0,0 +1,54 @@
+#ifndef PROJECT_BASE_TEXTURE_COMPRESSION_H
+#define PROJECT_BASE_TEXTURE_COMPRESSION_H
+
+#include <rg/model_cache.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+    // Block compressed formats, all made of 4x4 texel blocks.
+    enum class BlockFormat : std::uint32_t {
+        BC1,    // RGB, 8 bytes per block
+        BC3,    // RGBA, BC1 color and a BC4 alpha block, 16 bytes
+        BC4,    // one channel, 8 bytes
+        BC5     // two channels as two BC4 blocks, 16 bytes
+    };
+
+    std::size_t blockBytes(BlockFormat format);
+
+    // Bytes of one level; partial blocks at the edges count as whole ones.
+    std::size_t compressedSize(BlockFormat format, int width, int height);
+
+    // Encodes an 8-bit image with components channels, rows tightly packed. BC1 and BC3 read
+    // RGB(A), BC4 the first channel and BC5 the first two. Color endpoints are fit along the
+    // principal axis of each block, which is fast enough to run while loading.
+    std::vector<unsigned char> compressImage(const unsigned char *pixels, int width, int height,
+                                             int components, BlockFormat format);
+
+    // A mip chain read from a DDS file, in place.
+    struct CompressedTextureFile {
+        BlockFormat format = BlockFormat::BC1;
+        int width = 0;
+        int height = 0;
+        std::vector<std::span<const std::byte>> levels;
+        MappedFile file;
+    };
+
+    // Transcoded textures are cached in DDS files next to their sources. The hash of the
+    // source and the encoder version are kept in the reserved header words, so stale files
+    // are told apart without decoding the source image.
+    constexpr std::uint32_t TEXTURE_ENCODER_VERSION = 1;
+
+    bool writeDDS(const std::string &path, std::uint64_t sourceHash, BlockFormat format, int width, int height,
+                  std::span<const std::vector<unsigned char>> levels);
+
+    // False when the file is missing, not one of ours, stale or truncated.
+    bool readDDS(const std::string &path, std::uint64_t sourceHash, CompressedTextureFile &texture);
+}
+
+#endif //PROJECT_BASE_TEXTURE_COMPRESSION_H
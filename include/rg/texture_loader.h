@@ -0,0 +1,166 @@
+#ifndef PROJECT_BASE_TEXTURE_LOADER_H
+#define PROJECT_BASE_TEXTURE_LOADER_H
+
+#include <rg/texture_compression.h>
+#include <rg/upload_ring.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+    // What a texture holds decides how it is stored: color as BC1 or, with alpha, BC3;
+    // normal maps keep X and Y only, as BC5 or RG8, and the shaders rebuild Z; height maps
+    // keep one channel, as BC4 or R8. Uncompressed textures get sized internal formats with
+    // no more channels than the data has.
+    enum class TextureUsage {
+        Color,
+        Normal,
+        Height
+    };
+
+    // One channel of a packed texture: the first channel of the image at path, or value
+    // where there is no path or the image cannot be read.
+    struct ChannelSource {
+        std::string path;
+        unsigned char value = 0;
+    };
+
+    // Decodes image files on the thread pool and streams them in on the GL thread. A load
+    // returns its texture name right away, holding a 1x1 white placeholder, so meshes can
+    // be built against it. uploadPending then uploads the mip levels of decoded images over
+    // the following frames, smallest first, through a ring of pixel buffers. The base level
+    // of the texture follows the uploads, so it sharpens as they arrive and nothing has to
+    // ask whether it is done.
+    //
+    // With compressTextures set the workers transcode to block compressed formats and keep
+    // the result next to the source as <source>.<usage>.dds; later loads read that file
+    // instead. Images that cannot be compressed, and BC1/BC3 ones on drivers without S3TC,
+    // are uploaded uncompressed.
+    class TextureLoader {
+        friend class ServiceLocator;
+    public:
+        struct Stats {
+            unsigned int pending = 0;       // requested, not uploaded yet
+            unsigned int streaming = 0;     // of the pending ones, decoded and uploading
+            unsigned int uploaded = 0;
+            unsigned int compressed = 0;    // of the uploaded ones
+            std::size_t uploadedBytes = 0;
+        };
+
+        TextureLoader(const TextureLoader &) = delete;
+        TextureLoader &operator=(const TextureLoader &) = delete;
+
+        // Starts decoding path on a worker. Images with an alpha channel clamp to the edge
+        // when clampTransparent is set, so their borders do not bleed in from the other
+        // side; everything else repeats.
+        unsigned int load(const std::string &path, TextureUsage usage = TextureUsage::Color,
+                          bool clampTransparent = false);
+
+        // Packs up to four single channel images into one texture, such as occlusion,
+        // roughness and metallic maps into the R, G and B of an ORM texture. Sources of
+        // different sizes are resampled to the largest one. Packed textures stay uncompressed, as
+        // BC1 would mix the unrelated channels.
+        unsigned int loadPacked(const std::vector<ChannelSource> &channels);
+
+        // Uploads mip levels of decoded images until about byteBudget bytes went to the
+        // driver, returns how many levels. Every streaming texture gets its next level in
+        // turn, so all of them show their small mips before any gets its full size. At
+        // least one level is uploaded when any is ready, so levels larger than the budget
+        // still make progress; nothing is when every pixel buffer is still read by the GPU.
+        unsigned int uploadPending(std::size_t byteBudget);
+
+        // Waits for every requested image and uploads it.
+        void finish();
+
+        // Deletes a texture returned by load. One still decoding is dropped when it arrives.
+        void release(unsigned int texture);
+
+        // Deletes the pixel buffers; call while the context is still current. The textures
+        // are left to their owners.
+        void release();
+
+        // Size of the uploaded levels of texture, 0 until it is uploaded.
+        std::size_t uploadedBytes(unsigned int texture) const;
+
+        Stats stats() const { return m_stats; }
+
+        // Builds the mip chain on the workers instead of with glGenerateMipmap. Compressed
+        // textures always do.
+        bool cpuMipmaps = true;
+        bool compressTextures = true;
+        // Stages uploads in pixel buffers of stagingBufferBytes each; with it off levels are
+        // uploaded straight from memory, and so are levels larger than a buffer.
+        bool pixelBuffers = true;
+        std::size_t stagingBufferBytes = 8 << 20;
+
+    private:
+        struct Request {
+            unsigned int texture = 0;
+            // tells a released texture apart from a later one that got the same name
+            unsigned int id = 0;
+            std::string path;
+            TextureUsage usage = TextureUsage::Color;
+            // a packed texture when not empty, path only names it then
+            std::vector<ChannelSource> channels;
+            bool clampTransparent = false;
+            bool mipmaps = false;
+            bool compress = false;
+            bool colorCompression = false;  // BC1 and BC3 are supported
+        };
+
+        struct Level {
+            int width = 0;
+            int height = 0;
+            std::size_t size = 0;
+            std::shared_ptr<const unsigned char> pixels;
+        };
+
+        struct DecodedImage {
+            Request request;
+            int components = 0;
+            bool transparent = false;
+            // set when the levels hold blocks rather than texels
+            std::optional<BlockFormat> blockFormat;
+            // empty when the file could not be decoded
+            std::vector<Level> levels;
+        };
+
+        // A decoded image whose levels are being uploaded, from the last one down.
+        struct Streaming {
+            DecodedImage image;
+            std::size_t remaining = 0;      // levels not uploaded yet
+            std::size_t baseLevel = 0;      // the texture's base level, the level count before any
+        };
+
+        TextureLoader() = default;
+
+        unsigned int submit(Request request);
+        static DecodedImage decode(const Request &request);
+        bool current(const Request &request) const;
+        void collectDecoded();
+        unsigned int stream(std::size_t byteBudget, bool wait);
+        void uploadLevel(const DecodedImage &image, std::size_t level, const void *pixels);
+        void showUploadedLevels(Streaming &streaming);
+
+        std::mutex m_mutex;
+        std::condition_variable m_decodedCondition;
+        std::deque<DecodedImage> m_decoded;
+        Stats m_stats;
+        // the GL thread's bookkeeping, the workers never touch these
+        unsigned int m_nextRequest = 0;
+        std::unordered_map<unsigned int, unsigned int> m_requests;   // texture -> pending request
+        std::unordered_map<unsigned int, std::size_t> m_uploadedBytes;
+        std::deque<Streaming> m_streaming;
+        std::unique_ptr<UploadRing> m_uploadRing;
+    };
+}
+
+#endif //PROJECT_BASE_TEXTURE_LOADER_H
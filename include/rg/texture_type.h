@@ -0,0 +1,87 @@
+#ifndef PROJECT_BASE_TEXTURE_TYPE_H
+#define PROJECT_BASE_TEXTURE_TYPE_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace rg {
+
+    // What a texture is to the shaders, which sample it as texture_<type><N>. Every type has
+    // its own texture units, so a sampler reads the same unit in every program and is set
+    // once when the program is linked, never per draw.
+    enum class TextureType : std::uint8_t {
+        Diffuse,
+        Specular,
+        Normal,
+        Height,
+        ORM         // occlusion, roughness and metallic in R, G and B
+    };
+
+    inline constexpr unsigned int TEXTURE_TYPE_COUNT = 5;
+    // samplers of one type a shader may declare, texture_diffuse1 and texture_diffuse2
+    inline constexpr unsigned int MAX_TEXTURES_PER_TYPE = 2;
+
+    // The sampler name without its number; model caches store textures by it.
+    inline const char *textureTypeName(TextureType type) {
+        constexpr const char *names[TEXTURE_TYPE_COUNT] = {
+                "texture_diffuse", "texture_specular", "texture_normal", "texture_height", "texture_orm"
+        };
+        return names[static_cast<unsigned int>(type)];
+    }
+
+    inline std::optional<TextureType> textureTypeFromName(std::string_view name) {
+        for (unsigned int type = 0; type < TEXTURE_TYPE_COUNT; ++type) {
+            if (name == textureTypeName(static_cast<TextureType>(type)))
+                return static_cast<TextureType>(type);
+        }
+        return std::nullopt;
+    }
+
+    // Unit of the texture of type with the given index, counted from 0.
+    inline constexpr unsigned int textureUnit(TextureType type, unsigned int index) {
+        return static_cast<unsigned int>(type) * MAX_TEXTURES_PER_TYPE + index;
+    }
+
+    // texture_diffuse1 for the first diffuse texture
+    inline std::string textureSamplerName(TextureType type, unsigned int index) {
+        return textureTypeName(type) + std::to_string(index + 1);
+    }
+
+    // Units past the material ones hold the textures every draw of a frame shares. Their
+    // samplers are pointed at them when a program is linked too.
+    enum SharedTextureUnit : unsigned int {
+        CLUSTER_GRID_UNIT = TEXTURE_TYPE_COUNT * MAX_TEXTURES_PER_TYPE,
+        CLUSTER_LIGHT_INDICES_UNIT,
+        POINT_LIGHTS_UNIT,
+        SHADOW_CASCADES_UNIT,
+    };
+
+    // The deferred lighting pass binds no material, so the G-buffer reuses the first
+    // material units rather than taking four of the sixteen every program can sample.
+    enum GBufferTextureUnit : unsigned int {
+        GBUFFER_ALBEDO_OCCLUSION_UNIT = 0,
+        GBUFFER_NORMAL_UNIT,
+        GBUFFER_MATERIAL_UNIT,
+        GBUFFER_DEPTH_UNIT,
+    };
+
+    struct SharedSampler {
+        const char *name;
+        unsigned int unit;
+    };
+
+    inline constexpr SharedSampler SHARED_SAMPLERS[] = {
+            {"clusterGrid",         CLUSTER_GRID_UNIT},
+            {"clusterLightIndices", CLUSTER_LIGHT_INDICES_UNIT},
+            {"pointLights",         POINT_LIGHTS_UNIT},
+            {"shadowCascades",      SHADOW_CASCADES_UNIT},
+            {"gAlbedoOcclusion",    GBUFFER_ALBEDO_OCCLUSION_UNIT},
+            {"gNormal",             GBUFFER_NORMAL_UNIT},
+            {"gMaterial",           GBUFFER_MATERIAL_UNIT},
+            {"gDepth",              GBUFFER_DEPTH_UNIT},
+    };
+}
+
+#endif //PROJECT_BASE_TEXTURE_TYPE_H
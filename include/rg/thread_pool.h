@@ -0,0 +1,97 @@
+#ifndef PROJECT_BASE_THREAD_POOL_H
+#define PROJECT_BASE_THREAD_POOL_H
+
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace rg {
+
+    // Fixed set of worker threads running queued tasks in submission order. Tasks must not
+    // touch OpenGL, the context is only current on the main thread.
+    class ThreadPool {
+        friend class ServiceLocator;
+    public:
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        template<typename Task>
+        std::future<std::invoke_result_t<std::decay_t<Task>>> submit(Task &&task) {
+            using Result = std::invoke_result_t<std::decay_t<Task>>;
+            // std::function needs a copyable target, the packaged task is shared instead
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+            std::future<Result> future = packaged->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.emplace_back([packaged] { (*packaged)(); });
+            }
+            m_condition.notify_one();
+            return future;
+        }
+
+        // Calls body(i) for every i below count and returns once all calls are done. The
+        // calling thread takes indices too, so tasks may call this without waiting on
+        // workers that are all busy.
+        template<typename Body>
+        void parallelFor(std::size_t count, Body &&body) {
+            struct Progress {
+                std::atomic<std::size_t> next{0};
+                std::atomic<std::size_t> done{0};
+                std::mutex mutex;
+                std::condition_variable finished;
+            };
+            if (count == 0) {
+                return;
+            }
+            auto progress = std::make_shared<Progress>();
+            // helpers starting after the last index was taken return without touching body
+            auto work = [progress, count, &body] {
+                for (std::size_t i; (i = progress->next++) < count;) {
+                    body(i);
+                    if (++progress->done == count) {
+                        std::lock_guard<std::mutex> lock(progress->mutex);
+                        progress->finished.notify_all();
+                    }
+                }
+            };
+            std::size_t helpers = std::min<std::size_t>(count - 1, m_threads.size());
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (std::size_t i = 0; i < helpers; ++i) {
+                    m_tasks.emplace_back(work);
+                }
+            }
+            m_condition.notify_all();
+            work();
+            std::unique_lock<std::mutex> lock(progress->mutex);
+            progress->finished.wait(lock, [&] { return progress->done == count; });
+        }
+
+        unsigned int threadCount() const { return m_threads.size(); }
+
+    private:
+        // one thread per core besides the main thread
+        ThreadPool();
+
+        void run();
+
+        std::vector<std::thread> m_threads;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        bool m_stopping = false;
+    };
+}
+
+#endif //PROJECT_BASE_THREAD_POOL_H
@@ -0,0 +1,165 @@
+#ifndef PROJECT_BASE_UNIFORM_BUFFER_H
+#define PROJECT_BASE_UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/service_locator.h>
+
+#include <cstddef>
+#include <cstring>
+
+namespace rg {
+
+    // Fixed binding points of the uniform blocks shared by all programs.
+    enum UniformBlockBinding : unsigned int {
+        FRAME_DATA_BINDING = 0,
+        LIGHTS_BINDING = 1,
+        // rebound per draw to the buffer of the material being drawn, see Material
+        MATERIAL_BINDING = 2,
+        CLUSTERS_BINDING = 3,
+        SHADOWS_BINDING = 4,
+    };
+
+    // CPU mirrors of the std140 blocks declared in resources/shaders. A vec3 is aligned to
+    // 16 bytes but only occupies 12, so a following float packs into its last 4 bytes.
+    struct FrameDataBlock {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 viewPosition;
+        float pad0;
+    };
+
+    struct DirLightBlock {
+        glm::vec3 direction;
+        float pad0;
+        glm::vec3 ambient;
+        float pad1;
+        glm::vec3 diffuse;
+        float pad2;
+        glm::vec3 specular;
+        float pad3;
+    };
+
+    struct PointLightBlock {
+        glm::vec3 position;
+        float pad0;
+        glm::vec3 specular;
+        float pad1;
+        glm::vec3 diffuse;
+        float pad2;
+        glm::vec3 ambient;
+        float constant;
+        float linear;
+        float quadratic;
+        float pad3[2];
+    };
+
+    struct LightsBlock {
+        DirLightBlock dirLight;
+        PointLightBlock pointLight;
+    };
+
+    struct MaterialBlock {
+        float shininess = 32.0f;
+        float pad0[3] = {};
+    };
+
+    // How a fragment finds its cluster, see LightClusters.
+    struct ClusterDataBlock {
+        glm::uvec4 gridSize;        // x, y and z, w unused
+        glm::vec2 tilePixels;       // window pixels per cluster in x and y
+        float sliceScale;           // the z slice is log(view depth) * sliceScale + sliceBias
+        float sliceBias;
+    };
+
+    inline constexpr unsigned int MAX_SHADOW_CASCADES = 4;
+
+    // The cascades of the directional light's shadow, see ShadowCascades.
+    struct ShadowDataBlock {
+        glm::mat4 lightSpace[MAX_SHADOW_CASCADES];  // world to shadow map clip space
+        glm::vec4 cascadeSplits;    // view depth at which each cascade ends
+        glm::vec4 normalOffsets;    // per cascade, how far receivers are pushed along the normal
+        int cascadeCount;
+        float depthBias;
+        float pad0[2];
+    };
+
+    static_assert(offsetof(FrameDataBlock, viewPosition) == 128 && sizeof(FrameDataBlock) == 144);
+    static_assert(offsetof(PointLightBlock, constant) == 60 && sizeof(PointLightBlock) == 80);
+    static_assert(sizeof(DirLightBlock) == 64);
+    static_assert(offsetof(LightsBlock, pointLight) == 64 && sizeof(LightsBlock) == 144);
+    static_assert(sizeof(MaterialBlock) == 16);
+    static_assert(offsetof(ClusterDataBlock, sliceScale) == 24 && sizeof(ClusterDataBlock) == 32);
+    static_assert(offsetof(ShadowDataBlock, cascadeCount) == 288 && sizeof(ShadowDataBlock) == 304);
+
+    // Connects the blocks a program declares to their binding points. Called once after linking.
+    inline void bindUniformBlocks(unsigned int program) {
+        struct BlockBinding {
+            const char *name;
+            unsigned int binding;
+        };
+        constexpr BlockBinding blocks[] = {
+                {"FrameData",    FRAME_DATA_BINDING},
+                {"Lights",       LIGHTS_BINDING},
+                {"MaterialData", MATERIAL_BINDING},
+                {"ClusterData",  CLUSTERS_BINDING},
+                {"ShadowData",   SHADOWS_BINDING},
+        };
+        for (const BlockBinding &block : blocks) {
+            unsigned int index = glGetUniformBlockIndex(program, block.name);
+            if (index != GL_INVALID_INDEX) {
+                glUniformBlockBinding(program, index, block.binding);
+            }
+        }
+    }
+
+    // Buffer backing one uniform block, bound to its binding point through GLState. Every
+    // program that declares the block reads the same data, so it is uploaded once per frame.
+    // Buffers with a binding point of their own stay bound; ones sharing a binding point,
+    // like those of the materials, are bound again before they are drawn with.
+    template<typename Block>
+    class UniformBuffer {
+    public:
+        explicit UniformBuffer(unsigned int binding, GLenum usage = GL_DYNAMIC_DRAW)
+            : m_binding(binding) {
+            glGenBuffers(1, &m_UBO);
+            glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, usage);
+            bind();
+        }
+
+        ~UniformBuffer() {
+            ServiceLocator::Get().getGLState().forgetUniformBuffer(m_UBO);
+            glDeleteBuffers(1, &m_UBO);
+        }
+
+        UniformBuffer(const UniformBuffer &) = delete;
+        UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+        void update(const Block &block) {
+            if (m_hasData && std::memcmp(&m_data, &block, sizeof(Block)) == 0) {
+                return;
+            }
+            m_data = block;
+            m_hasData = true;
+            glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &m_data);
+        }
+
+        // Binds the buffer to its binding point, filtered by GLState.
+        void bind() const {
+            ServiceLocator::Get().getGLState().bindUniformBuffer(m_binding, m_UBO);
+        }
+
+        // The last update
+        const Block &data() const { return m_data; }
+
+    private:
+        unsigned int m_binding = 0;
+        unsigned int m_UBO = 0;
+        bool m_hasData = false;
+        Block m_data{};
+    };
+}
+
+#endif //PROJECT_BASE_UNIFORM_BUFFER_H
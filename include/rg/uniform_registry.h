@@ -0,0 +1,162 @@
+#ifndef PROJECT_BASE_UNIFORM_REGISTRY_H
+#define PROJECT_BASE_UNIFORM_REGISTRY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+    // Index of an active uniform in the table of the program it was looked up in.
+    struct UniformHandle {
+        int index = -1;
+        bool valid() const { return index >= 0; }
+    };
+
+    // Flat table of the active uniforms of one linked program. Locations are queried once,
+    // when the program is reflected, and every slot keeps a shadow copy of the last value
+    // uploaded so that setting the same value again does not reach the driver.
+    class UniformRegistry {
+    public:
+        struct FrameStats {
+            unsigned int lookups = 0;   // name -> handle resolutions
+            unsigned int uploads = 0;   // glUniform* calls that were issued
+            unsigned int skipped = 0;   // uploads dropped because the value did not change
+        };
+
+        void reflect(unsigned int program) {
+            m_slots.clear();
+            m_names.clear();
+
+            GLint count = 0;
+            GLint maxNameLength = 0;
+            glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+            glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+            std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+            for (GLint i = 0; i < count; ++i) {
+                GLsizei length = 0;
+                GLint size = 0;
+                GLenum type = GL_NONE;
+                glGetActiveUniform(program, i, nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+                std::string name(nameBuffer.data(), length);
+                // members of uniform blocks have no location, they are fed through buffers
+                GLint location = glGetUniformLocation(program, name.c_str());
+                if (location < 0) {
+                    continue;
+                }
+                // arrays are reported as "name[0]"; register every element, the bare name
+                // shares the slot of the first one
+                if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                    std::string base = name.substr(0, name.size() - 3);
+                    m_names.emplace(base, addSlot(name, location, type));
+                    for (GLint element = 1; element < size; ++element) {
+                        std::string elementName = base + "[" + std::to_string(element) + "]";
+                        addSlot(elementName, glGetUniformLocation(program, elementName.c_str()), type);
+                    }
+                } else {
+                    addSlot(name, location, type);
+                }
+            }
+        }
+
+        UniformHandle find(const std::string &name) const {
+            ++stats().lookups;
+            auto it = m_names.find(name);
+            return it != m_names.end() ? UniformHandle{it->second} : UniformHandle{};
+        }
+
+        void set(UniformHandle handle, int value) {
+            if (update(handle, &value, sizeof(value)))
+                glUniform1i(m_slots[handle.index].location, value);
+        }
+
+        void set(UniformHandle handle, float value) {
+            if (update(handle, &value, sizeof(value)))
+                glUniform1f(m_slots[handle.index].location, value);
+        }
+
+        void set(UniformHandle handle, const glm::vec2 &value) {
+            if (update(handle, &value[0], sizeof(value)))
+                glUniform2fv(m_slots[handle.index].location, 1, &value[0]);
+        }
+
+        void set(UniformHandle handle, const glm::vec3 &value) {
+            if (update(handle, &value[0], sizeof(value)))
+                glUniform3fv(m_slots[handle.index].location, 1, &value[0]);
+        }
+
+        void set(UniformHandle handle, const glm::vec4 &value) {
+            if (update(handle, &value[0], sizeof(value)))
+                glUniform4fv(m_slots[handle.index].location, 1, &value[0]);
+        }
+
+        void set(UniformHandle handle, const glm::mat2 &value) {
+            if (update(handle, &value[0][0], sizeof(value)))
+                glUniformMatrix2fv(m_slots[handle.index].location, 1, GL_FALSE, &value[0][0]);
+        }
+
+        void set(UniformHandle handle, const glm::mat3 &value) {
+            if (update(handle, &value[0][0], sizeof(value)))
+                glUniformMatrix3fv(m_slots[handle.index].location, 1, GL_FALSE, &value[0][0]);
+        }
+
+        void set(UniformHandle handle, const glm::mat4 &value) {
+            if (update(handle, &value[0][0], sizeof(value)))
+                glUniformMatrix4fv(m_slots[handle.index].location, 1, GL_FALSE, &value[0][0]);
+        }
+
+        std::size_t size() const { return m_slots.size(); }
+
+        // Counters shared by every program; main resets them at the start of each frame.
+        static FrameStats &stats() {
+            static FrameStats frameStats;
+            return frameStats;
+        }
+
+        static void resetFrameStats() { stats() = FrameStats{}; }
+
+    private:
+        struct Slot {
+            GLint location = -1;
+            GLenum type = GL_NONE;
+            bool hasValue = false;
+            std::array<unsigned char, sizeof(glm::mat4)> shadow{};
+        };
+
+        int addSlot(const std::string &name, GLint location, GLenum type) {
+            Slot slot;
+            slot.location = location;
+            slot.type = type;
+            int index = (int) m_slots.size();
+            m_names.emplace(name, index);
+            m_slots.push_back(slot);
+            return index;
+        }
+
+        // Returns true when the value differs from the shadow copy and has to be uploaded.
+        bool update(UniformHandle handle, const void *value, std::size_t size) {
+            if (!handle.valid())
+                return false;
+            Slot &slot = m_slots[handle.index];
+            if (slot.hasValue && std::memcmp(slot.shadow.data(), value, size) == 0) {
+                ++stats().skipped;
+                return false;
+            }
+            std::memcpy(slot.shadow.data(), value, size);
+            slot.hasValue = true;
+            ++stats().uploads;
+            return true;
+        }
+
+        std::vector<Slot> m_slots;
+        std::unordered_map<std::string, int> m_names;
+    };
+}
+
+#endif //PROJECT_BASE_UNIFORM_REGISTRY_H
@@ -0,0 +1,57 @@
+#ifndef PROJECT_BASE_UPLOAD_RING_H
+#define PROJECT_BASE_UPLOAD_RING_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace rg {
+
+    // Ring of pixel unpack buffers staging texture data for the driver. Every batch of
+    // uploads is copied into the next buffer, and the texture calls read it from there,
+    // so they return without copying and the transfer overlaps rendering. A buffer is
+    // only mapped again once a fence shows the GPU finished reading it.
+    //
+    // A batch is begin, any number of stage calls, unmap, the texture calls reading the
+    // returned offsets, and end. Nothing else may bind GL_PIXEL_UNPACK_BUFFER meanwhile.
+    class UploadRing {
+    public:
+        UploadRing(unsigned int buffers, std::size_t bufferBytes);
+        ~UploadRing();
+
+        UploadRing(const UploadRing &) = delete;
+        UploadRing &operator=(const UploadRing &) = delete;
+
+        // Maps the next buffer. False when the GPU still reads it, or the driver would not
+        // map it, unless wait is set, which blocks until the GPU is done instead.
+        bool begin(bool wait = false);
+
+        // Copies size bytes into the mapped buffer and returns their offset, which the
+        // texture calls take in place of a pointer; nullopt when they do not fit.
+        std::optional<std::size_t> stage(const void *data, std::size_t size);
+
+        // Unmaps the buffer, it stays bound for the texture calls.
+        void unmap();
+
+        // Unbinds the buffer and fences the texture calls that read it.
+        void end();
+
+        std::size_t bufferBytes() const { return m_bufferBytes; }
+
+    private:
+        struct Buffer {
+            unsigned int name = 0;
+            GLsync fence = nullptr;
+        };
+
+        std::vector<Buffer> m_buffers;
+        std::size_t m_bufferBytes = 0;
+        unsigned int m_current = 0;
+        unsigned char *m_mapped = nullptr;
+        std::size_t m_used = 0;
+    };
+}
+
+#endif //PROJECT_BASE_UPLOAD_RING_H
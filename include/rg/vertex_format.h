@@ -0,0 +1,115 @@
+#ifndef PROJECT_BASE_VERTEX_FORMAT_H
+#define PROJECT_BASE_VERTEX_FORMAT_H
+
+#include <glm/glm.hpp>
+#include <rg/bounds.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace rg {
+
+    // Float keeps the full 56 byte Vertex on the GPU, which is handy when debugging vertex
+    // data; Packed uploads PackedVertex instead.
+    enum class VertexFormat {
+        Float,
+        Packed
+    };
+
+    // 20 bytes per vertex, decoded by the vertex shaders:
+    //  location 0: positions as normalized int16 relative to the mesh bounds, w unused
+    //  location 1: octahedral normal in x and y of GL_INT_2_10_10_10_REV
+    //  location 2: half float texture coordinates
+    //  location 3: octahedral tangent in x and y, the sign of w is the bitangent handedness
+    struct PackedVertex {
+        std::int16_t position[4];
+        std::uint32_t normal;
+        std::uint32_t tangent;
+        std::uint16_t texCoords[2];
+    };
+    static_assert(sizeof(PackedVertex) == 20);
+
+    // Maps the normalized positions back to object space: position * scale + offset. The
+    // float layout uses the identity.
+    struct VertexQuantization {
+        glm::vec3 offset{0.0f};
+        glm::vec3 scale{1.0f};
+
+        static VertexQuantization fromBounds(const AABB &bounds) {
+            VertexQuantization quantization;
+            if (bounds.empty())
+                return quantization;
+            quantization.offset = bounds.center();
+            glm::vec3 extent = bounds.extent();
+            // flat meshes still need a non zero scale on their flat axis
+            quantization.scale = glm::vec3(std::max(extent.x, 1e-6f), std::max(extent.y, 1e-6f),
+                                           std::max(extent.z, 1e-6f));
+            return quantization;
+        }
+    };
+
+    // Projects a unit vector onto the octahedron and unfolds the lower half over the upper.
+    inline glm::vec2 octahedralEncode(const glm::vec3 &v) {
+        float length = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        if (length == 0.0f)
+            return glm::vec2(0.0f);
+        glm::vec2 e(v.x / length, v.y / length);
+        if (v.z < 0.0f) {
+            glm::vec2 folded((1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                             (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+            e = folded;
+        }
+        return e;
+    }
+
+    // Round to nearest; values too small for a normal half flush to zero, which no texture
+    // coordinate needs.
+    inline std::uint16_t floatToHalf(float value) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        std::uint32_t sign = (bits >> 16) & 0x8000u;
+        int exponent = static_cast<int>((bits >> 23) & 0xFFu) - 127 + 15;
+        std::uint32_t mantissa = bits & 0x7FFFFFu;
+        if (exponent <= 0)
+            return static_cast<std::uint16_t>(sign);
+        if (exponent >= 31)
+            return static_cast<std::uint16_t>(sign | 0x7C00u);
+        std::uint32_t half = sign | static_cast<std::uint32_t>(exponent) << 10 | mantissa >> 13;
+        // a carry out of the mantissa correctly bumps the exponent
+        if (mantissa & 0x1000u)
+            ++half;
+        return static_cast<std::uint16_t>(half);
+    }
+
+    inline std::int16_t packSnorm16(float value) {
+        return static_cast<std::int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    }
+
+    // x and y as normalized 10 bit integers, z zero and w as a 2 bit integer
+    inline std::uint32_t packSnorm2_10_10_10(const glm::vec2 &xy, int w) {
+        auto snorm10 = [](float value) {
+            return static_cast<std::uint32_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f)) & 0x3FFu;
+        };
+        return snorm10(xy.x) | snorm10(xy.y) << 10 | (static_cast<std::uint32_t>(w) & 0x3u) << 30;
+    }
+
+    inline PackedVertex packVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoords,
+                                   const glm::vec3 &tangent, const glm::vec3 &bitangent,
+                                   const VertexQuantization &quantization) {
+        PackedVertex packed{};
+        glm::vec3 relative = (position - quantization.offset) / quantization.scale;
+        packed.position[0] = packSnorm16(relative.x);
+        packed.position[1] = packSnorm16(relative.y);
+        packed.position[2] = packSnorm16(relative.z);
+        packed.normal = packSnorm2_10_10_10(octahedralEncode(normal), 0);
+        int handedness = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1 : 1;
+        packed.tangent = packSnorm2_10_10_10(octahedralEncode(tangent), handedness);
+        packed.texCoords[0] = floatToHalf(texCoords.x);
+        packed.texCoords[1] = floatToHalf(texCoords.y);
+        return packed;
+    }
+}
+
+#endif //PROJECT_BASE_VERTEX_FORMAT_H
@@ -1,5 +1,12 @@
 #version 330 core
+#ifdef GBUFFER
+// the surface goes to the G-buffer and is lit later, see rg::GBuffer
+layout (location = 0) out vec4 OutAlbedoOcclusion;
+layout (location = 1) out vec2 OutNormal;
+layout (location = 2) out vec4 OutMaterial;
+#else
 out vec4 FragColor;
+#endif
 
 struct PointLight {
     vec3 position;
@@ -21,106 +28,130 @@ struct DirLight {
     vec3 specular;
 };
 
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_diffuse2;
-
-    float shininess;
-};
-
+#ifndef DEFERRED_LIGHTING
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+#ifdef NORMAL_MAP
+in vec3 Tangent;
+in vec3 Bitangent;
+#endif
+flat in float Fade;
+#endif
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
-uniform PointLight pointLight;
-uniform DirLight dirLight;
-uniform Material material;
-uniform bool Blinn;
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+};
 
-uniform vec3 viewPosition;
-// calculates the color when using a point light.
+#ifdef DEFERRED_LIGHTING
+// a full-screen pass lighting the G-buffer, see rg::GBuffer
+uniform sampler2D gAlbedoOcclusion;
+uniform sampler2D gNormal;
+uniform sampler2D gMaterial;
+uniform sampler2D gDepth;
+// from normalized device coordinates back to world space
+uniform mat4 inverseViewProjection;
+#else
+// per material, see rg::MaterialBlock
+layout (std140) uniform MaterialData {
+    float shininess;
+} material;
+
+// bound to the units of their types when the program is linked, see rg::TextureType
+uniform sampler2D texture_diffuse1;
+#ifdef DIFFUSE2
+uniform sampler2D texture_diffuse2;
+#endif
+#ifdef NORMAL_MAP
+// tangent space X and Y, Z is rebuilt
+uniform sampler2D texture_normal1;
+#endif
+// occlusion, roughness and metallic in R, G and B
+uniform sampler2D texture_orm1;
+#endif
+
+#include "include/shading.glsl"
+
+#ifndef DEFERRED_LIGHTING
+Surface SampleSurface()
+{
+    vec3 albedo = vec3(texture(texture_diffuse1, TexCoords));
+#ifdef DIFFUSE2
+    albedo += vec3(texture(texture_diffuse2, TexCoords));
+#endif
+    vec3 orm = texture(texture_orm1, TexCoords).rgb;
+    return MakeSurface(albedo, orm.r, orm.g, orm.b, material.shininess);
+}
 
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 SurfaceNormal()
 {
-    vec3 lightDir = normalize(light.position - fragPos);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    float spec = 0.0;
-
-    //Blinn-Phong
-    if(Blinn){
-       vec3 halfwayDir = normalize(lightDir + viewDir);
-       spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }else{
-       vec3 reflectDir = reflect(-lightDir, normal);
-       spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
-
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0/(light.constant + light.linear * distance + light.quadratic * (distance * distance));
-    // combine results
-
-    //ambient
-    vec3 ambientFirst = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 ambientSecond = light.ambient * vec3(texture(material.texture_diffuse2, TexCoords));
-    vec3 ambient = ambientFirst + ambientSecond;
-
-    //diffuse
-    vec3 diffuseFirst = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuseSecond = light.diffuse * diff * vec3(texture(material.texture_diffuse2, TexCoords));
-    vec3 diffuse = diffuseFirst + diffuseSecond;
-
-    //specular
-    vec3 specular = light.specular * spec; //* vec3(texture(material.texture_specular1, TexCoords).xxx);
-
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+#ifdef NORMAL_MAP
+    vec2 normalXY = texture(texture_normal1, TexCoords).rg * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
+    mat3 TBN = mat3(normalize(Tangent), normalize(Bitangent), normalize(Normal));
+    return normalize(TBN * tangentNormal);
+#else
+    return normalize(Normal);
+#endif
 }
+#endif
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+#include "include/octahedral.glsl"
+
+#ifdef DEFERRED_LIGHTING
+void main()
 {
-    vec3 lightDir = normalize(-light.direction);
-    // diffuse shading
-    float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    float spec = 0.0;
-
-    //Blinn-Phong
-    if(Blinn){
-           vec3 halfwayDir = normalize(lightDir + viewDir);
-           spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-        }else{
-           vec3 reflectDir = reflect(-lightDir, normal);
-           spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-        }
-
-    // combine results
-
-    //ambient
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-
-    //diffuse
-    vec3 diffuseFirst = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuseSecond = light.diffuse * diff * vec3(texture(material.texture_diffuse2, TexCoords));
-    vec3 diffuse = diffuseFirst + diffuseSecond;
-
-    vec3 specular = light.specular * spec; //* vec3(texture(material.texture_specular1, TexCoords).xxx);
-
-    return (ambient + diffuse + specular);
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing was drawn here, the clear color stays
+    if (depth == 1.0)
+        discard;
+    vec4 albedoOcclusion = texelFetch(gAlbedoOcclusion, pixel, 0);
+    vec4 materialData = texelFetch(gMaterial, pixel, 0);
+    Surface surface = MakeSurface(albedoOcclusion.rgb, albedoOcclusion.a,
+                                  materialData.r, materialData.g, materialData.b * 256.0);
+    vec3 normal = OctahedralDecode(texelFetch(gNormal, pixel, 0).rg * 2.0 - 1.0);
+    vec3 ndc = vec3(gl_FragCoord.xy / vec2(textureSize(gDepth, 0)), depth) * 2.0 - 1.0;
+    vec4 position = inverseViewProjection * vec4(ndc, 1.0);
+
+    FragColor = vec4(Shade(surface, normal, position.xyz / position.w), 1.0);
+    // every sample of the pixel takes the G-buffer depth, for the forward passes after
+    gl_FragDepth = depth;
+}
+#else
+// ordered dither threshold in (0, 1) from a 4x4 Bayer matrix
+float BayerThreshold()
+{
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                      3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
 }
 
 void main()
 {
-    vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
-    //directional light
-    vec3 result = CalcDirLight(dirLight, normal, viewDir);
-    //add point light
-    result += CalcPointLight(pointLight, normal, FragPos, viewDir);
-
-    FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+    // LOD cross-fade: the incoming level (Fade > 0) and the outgoing one (Fade < 0)
+    // cover complementary pixels
+    if (Fade > 0.0 && BayerThreshold() >= Fade)
+        discard;
+    if (Fade < 0.0 && BayerThreshold() < -Fade)
+        discard;
+
+    Surface surface = SampleSurface();
+    vec3 normal = SurfaceNormal();
+#ifdef GBUFFER
+    OutAlbedoOcclusion = vec4(surface.albedo, surface.occlusion);
+    OutNormal = OctahedralEncode(normal) * 0.5 + 0.5;
+    OutMaterial = vec4(surface.roughness, surface.metallic, surface.shininess / 256.0, 0.0);
+#else
+    FragColor = vec4(Shade(surface, normal, FragPos), 1.0);
+#endif
+}
+#endif
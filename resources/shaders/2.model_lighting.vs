@@ -1,20 +1,50 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
-layout (location = 2) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec4 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+#ifdef NORMAL_MAP
+layout (location = 3) in vec4 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+layout (location = 5) in mat4 aInstanceModel;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+#ifdef NORMAL_MAP
+out vec3 Tangent;
+out vec3 Bitangent;
+#endif
+flat out float Fade;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// packed meshes store positions relative to their bounds and octahedral
+// normals, see rg::PackedVertex
+uniform bool packedVertices;
+uniform vec3 quantizationOffset;
+uniform vec3 quantizationScale;
+
+#include "include/octahedral.glsl"
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+    // the LOD cross-fade rides in the unused bottom row of the first column
+    mat4 model = aInstanceModel;
+    Fade = model[0][3];
+    model[0][3] = 0.0;
+    vec3 position = aPos.xyz * quantizationScale + quantizationOffset;
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = packedVertices ? OctahedralDecode(aNormal.xy) : aNormal.xyz;
+#ifdef NORMAL_MAP
+    // in the same space as Normal
+    Tangent = packedVertices ? OctahedralDecode(aTangent.xy) : aTangent.xyz;
+    Bitangent = packedVertices ? cross(Normal, Tangent) * sign(aTangent.w) : aBitangent;
+#endif
     TexCoords = aTexCoords;    
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
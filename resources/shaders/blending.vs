@@ -1,15 +1,22 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
+layout (location = 0) in vec4 aPos;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstanceModel;
 
 out vec2 TexCoords;
 
-uniform mat4 model7;
-uniform mat4 view;
-uniform mat4 projection;
+// packed meshes store positions relative to their bounds, see rg::PackedVertex
+uniform vec3 quantizationOffset;
+uniform vec3 quantizationScale;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model7 * vec4(aPos, 1.0);
+    gl_Position = projection * view * aInstanceModel * vec4(aPos.xyz * quantizationScale + quantizationOffset, 1.0);
 }
\ No newline at end of file
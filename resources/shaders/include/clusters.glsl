@@ -0,0 +1,44 @@
+// the point lights come from the clusters, see rg::LightClusters; include after the
+// FrameData block and the PointLight struct
+layout (std140) uniform ClusterData {
+    uvec4 clusterGridSize;
+    vec2 clusterTilePixels;
+    float clusterSliceScale;
+    float clusterSliceBias;
+};
+
+// offset and count of the lights of every cluster in clusterLightIndices
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+// four texels per light, see rg::PointLightData
+uniform samplerBuffer pointLights;
+
+// offset and count of the lights of the cluster the fragment is in
+uvec2 ClusterLights(vec3 fragPos)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    uvec3 cluster;
+    cluster.xy = uvec2(gl_FragCoord.xy / clusterTilePixels);
+    cluster.z = uint(max(log(depth) * clusterSliceScale + clusterSliceBias, 0.0));
+    cluster = min(cluster, clusterGridSize.xyz - 1u);
+    int index = int(cluster.x + clusterGridSize.x * (cluster.y + clusterGridSize.y * cluster.z));
+    return texelFetch(clusterGrid, index).rg;
+}
+
+PointLight FetchPointLight(int index, out float radius)
+{
+    vec4 positionRadius = texelFetch(pointLights, index * 4);
+    vec4 ambientConstant = texelFetch(pointLights, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(pointLights, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(pointLights, index * 4 + 3);
+    PointLight light;
+    light.position = positionRadius.xyz;
+    light.ambient = ambientConstant.rgb;
+    light.diffuse = diffuseLinear.rgb;
+    light.specular = specularQuadratic.rgb;
+    light.constant = ambientConstant.w;
+    light.linear = diffuseLinear.w;
+    light.quadratic = specularQuadratic.w;
+    radius = positionRadius.w;
+    return light;
+}
@@ -0,0 +1,105 @@
+// the lighting shared by the forward and deferred shaders: the directional light, shadowed
+// with SHADOWS, and with POINT_LIGHT the point lights of the fragment's cluster. Include after
+// the FrameData and Lights blocks.
+#ifdef SHADOWS
+#include "shadows.glsl"
+#endif
+#ifdef POINT_LIGHT
+#include "clusters.glsl"
+#endif
+
+// the material under the fragment, sampled once and shared by every light
+struct Surface {
+    vec3 albedo;
+    float occlusion;        // the share of ambient light reaching the surface
+    float roughness;
+    float metallic;
+    float shininess;
+    vec3 specularColor;     // rough surfaces reflect less sharply, metals in their own color
+};
+
+Surface MakeSurface(vec3 albedo, float occlusion, float roughness, float metallic, float shininess)
+{
+    Surface surface;
+    surface.albedo = albedo;
+    surface.occlusion = occlusion;
+    surface.roughness = roughness;
+    surface.metallic = metallic;
+    surface.shininess = shininess;
+    surface.specularColor = (1.0 - roughness) * mix(vec3(1.0), albedo, metallic);
+    return surface;
+}
+
+float Specular(vec3 lightDir, vec3 normal, vec3 viewDir, float shininess)
+{
+#ifdef BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    return pow(max(dot(normal, halfwayDir), 0.0), shininess);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    return pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+#endif
+}
+
+#ifdef POINT_LIGHT
+// calculates the color when using a point light. It fades out towards radius, past which
+// the clusters no longer list it.
+vec3 CalcPointLight(PointLight light, float radius, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    float spec = Specular(lightDir, normal, viewDir, surface.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0/(light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+    attenuation *= window * window;
+    // combine results
+    vec3 ambient = light.ambient * surface.albedo * surface.occlusion;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specularColor;
+    return (ambient + diffuse + specular) * attenuation;
+}
+#endif
+
+// shadow scales the direct light, ambient light reaches shadowed surfaces too
+vec3 CalcDirLight(DirLight light, Surface surface, vec3 normal, vec3 viewDir, float shadow)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    float spec = Specular(lightDir, normal, viewDir, surface.shininess);
+    // combine results
+    vec3 ambient = light.ambient * surface.albedo * surface.occlusion;
+    vec3 diffuse = light.diffuse * diff * surface.albedo;
+    vec3 specular = light.specular * spec * surface.specularColor;
+    return ambient + (diffuse + specular) * shadow;
+}
+
+// the directional light and the point lights of the cluster the fragment is in
+vec3 Shade(Surface surface, vec3 normal, vec3 fragPos)
+{
+    vec3 viewDir = normalize(viewPosition - fragPos);
+    //directional light
+#ifdef SHADOWS
+    float shadow = DirShadow(fragPos, normal);
+#else
+    float shadow = 1.0;
+#endif
+    vec3 result = CalcDirLight(dirLight, surface, normal, viewDir, shadow);
+#ifdef POINT_LIGHT
+    //add the point lights of the cluster
+    uvec2 lights = ClusterLights(fragPos);
+    for (uint i = 0u; i < lights.y; i++)
+    {
+        int index = int(texelFetch(clusterLightIndices, int(lights.x + i)).r);
+        float radius;
+        PointLight light = FetchPointLight(index, radius);
+        result += CalcPointLight(light, radius, surface, normal, fragPos, viewDir);
+    }
+#endif
+    return result;
+}
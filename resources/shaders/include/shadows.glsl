@@ -0,0 +1,37 @@
+// the cascaded shadow maps of the directional light, see rg::ShadowCascades; include after
+// the FrameData block, DirShadow reads its view matrix
+layout (std140) uniform ShadowData {
+    mat4 lightSpace[4];
+    vec4 cascadeSplits;
+    vec4 normalOffsets;
+    int cascadeCount;
+    float depthBias;
+};
+
+uniform sampler2DArrayShadow shadowCascades;
+
+// the share of the directional light reaching fragPos, four bilinear depth comparisons
+// half a texel apart
+float DirShadow(vec3 fragPos, vec3 normal)
+{
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int cascade = 0;
+    while (cascade < cascadeCount - 1 && depth > cascadeSplits[cascade])
+        cascade++;
+    if (depth > cascadeSplits[cascade])
+        return 1.0;
+    // pushed along the normal by a texel or so against acne
+    vec3 position = fragPos + normal * normalOffsets[cascade];
+    vec3 coords = (lightSpace[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+    vec2 texel = 1.0 / vec2(textureSize(shadowCascades, 0).xy);
+    float shadow = 0.0;
+    for (int x = -1; x <= 1; x += 2)
+    {
+        for (int y = -1; y <= 1; y += 2)
+        {
+            vec2 offset = vec2(x, y) * 0.5 * texel;
+            shadow += texture(shadowCascades, vec4(coords.xy + offset, cascade, coords.z - depthBias));
+        }
+    }
+    return shadow * 0.25;
+}
@@ -1,11 +1,18 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec4 aPos;
+layout (location = 5) in mat4 aInstanceModel;
 
-uniform mat4 model3;
-uniform mat4 view;
-uniform mat4 projection;
+// packed meshes store positions relative to their bounds, see rg::PackedVertex
+uniform vec3 quantizationOffset;
+uniform vec3 quantizationScale;
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
 
 void main()
 {
-    gl_Position = projection * view * model3 * vec4(aPos, 1.0);
+    gl_Position = projection * view * aInstanceModel * vec4(aPos.xyz * quantizationScale + quantizationOffset, 1.0);
 }
\ No newline at end of file
@@ -1,20 +1,60 @@
 #version 330 core
+#ifdef GBUFFER
+// the surface goes to the G-buffer and is lit later, see rg::GBuffer
+layout (location = 0) out vec4 OutAlbedoOcclusion;
+layout (location = 1) out vec2 OutNormal;
+layout (location = 2) out vec4 OutMaterial;
+#else
 out vec4 FragColor;
+#endif
 
 in VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
-    vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+    mat3 WorldFromTangent;
 } fs_in;
 
-uniform sampler2D diffuseMap;
-uniform sampler2D normalMap;
-uniform sampler2D depthMap;
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_normal1;
+uniform sampler2D texture_height1;
 
 uniform float heightScale;
 
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+};
+
+#include "include/shading.glsl"
+
 vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 {
           const float minLayers = 8;
@@ -34,12 +74,12 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 
           //initial values
           vec2  currentTexCoords     = texCoords;
-          float currentDepthMapValue = texture(depthMap, currentTexCoords).r;
+          float currentDepthMapValue = texture(texture_height1, currentTexCoords).r;
 
           while(currentLayerDepth < currentDepthMapValue)
           {
               currentTexCoords -= deltaTexCoords;
-              currentDepthMapValue = texture(depthMap, currentTexCoords).r;
+              currentDepthMapValue = texture(texture_height1, currentTexCoords).r;
               currentLayerDepth += layerDepth;
           }
 
@@ -48,7 +88,7 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 
 
           float afterDepth  = currentDepthMapValue - currentLayerDepth;
-          float beforeDepth = texture(depthMap, prevTexCoords).r - currentLayerDepth + layerDepth;
+          float beforeDepth = texture(texture_height1, prevTexCoords).r - currentLayerDepth + layerDepth;
 
           // interpolation of texture coordinates
           float weight = afterDepth / (afterDepth - beforeDepth);
@@ -57,6 +97,8 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
           return finalTexCoords;
 }
 
+#include "include/octahedral.glsl"
+
 void main()
 {
     // Parallax Mapping
@@ -68,22 +110,20 @@ void main()
       discard;
 
     //normal
-    vec3 normal = texture(normalMap, texCoords).rgb;
-    normal = normalize(normal * 2.0 - 1.0);
+    // BC5 normal maps only keep X and Y, Z is rebuilt from the unit length
+    vec2 normalXY = texture(texture_normal1, texCoords).rg * 2.0 - 1.0;
+    vec3 normal = normalize(vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0))));
 
     // get diffuse color
-    vec3 color = texture(diffuseMap, texCoords).rgb;
-    // ambient
-    vec3 ambient = 0.5 * color;
-    // diffuse
-    vec3 lightDir = normalize(fs_in.TangentLightPos - fs_in.TangentFragPos);
-    float diff = max(dot(lightDir, normal), 0.0);
-    vec3 diffuse = diff * color;
-    // specular
-    vec3 reflectDir = reflect(-lightDir, normal);
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-
-    vec3 specular = vec3(0.2) * spec;
-    FragColor = vec4(ambient + diffuse + specular, 1.0);
+    vec3 color = texture(texture_diffuse1, texCoords).rgb;
+#ifdef GBUFFER
+    // the lighting pass reads specular 0.2 at shininess 32 back as roughness 0.8
+    OutAlbedoOcclusion = vec4(color, 1.0);
+    OutNormal = OctahedralEncode(normalize(fs_in.WorldFromTangent * normal)) * 0.5 + 0.5;
+    OutMaterial = vec4(0.8, 0.0, 32.0 / 256.0, 0.0);
+#else
+    // lit like the deferred lighting pass lights the G-buffer surface above
+    Surface surface = MakeSurface(color, 1.0, 0.8, 0.0, 32.0);
+    FragColor = vec4(Shade(surface, normalize(fs_in.WorldFromTangent * normal), fs_in.FragPos), 1.0);
+#endif
 }
\ No newline at end of file
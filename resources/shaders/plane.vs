@@ -1,38 +1,81 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec4 aPos;
+layout (location = 1) in vec4 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
+layout (location = 3) in vec4 aTangent;
 layout (location = 4) in vec3 aBitangent;
+layout (location = 5) in mat4 aInstanceModel;
 
 out VS_OUT {
     vec3 FragPos;
     vec2 TexCoords;
-    vec3 TangentLightPos;
     vec3 TangentViewPos;
     vec3 TangentFragPos;
+    mat3 WorldFromTangent;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// packed meshes store positions relative to their bounds and octahedral normals and
+// tangents, see rg::PackedVertex
+uniform bool packedVertices;
+uniform vec3 quantizationOffset;
+uniform vec3 quantizationScale;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
+#include "include/octahedral.glsl"
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+layout (std140) uniform FrameData {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+};
 
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    mat4 model = aInstanceModel;
+    vec3 position = aPos.xyz * quantizationScale + quantizationOffset;
+    vs_out.FragPos = vec3(model * vec4(position, 1.0));
     vs_out.TexCoords = aTexCoords;
 
-    vec3 T = normalize(mat3(model) * aTangent);
-    vec3 B = normalize(mat3(model) * aBitangent);
-    vec3 N = normalize(mat3(model) * aNormal);
+    vec3 normal = aNormal.xyz;
+    vec3 tangent = aTangent.xyz;
+    vec3 bitangent = aBitangent;
+    if (packedVertices) {
+        normal = OctahedralDecode(aNormal.xy);
+        tangent = OctahedralDecode(aTangent.xy);
+        bitangent = cross(normal, tangent) * sign(aTangent.w);
+    }
+    vec3 T = normalize(mat3(model) * tangent);
+    vec3 B = normalize(mat3(model) * bitangent);
+    vec3 N = normalize(mat3(model) * normal);
     mat3 TBN = transpose(mat3(T, B, N));
+    vs_out.WorldFromTangent = mat3(T, B, N);
 
-    vs_out.TangentLightPos = TBN * lightPos;
-    vs_out.TangentViewPos  = TBN * viewPos;
+    vs_out.TangentViewPos  = TBN * viewPosition;
     vs_out.TangentFragPos  = TBN * vs_out.FragPos;
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
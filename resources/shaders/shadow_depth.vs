@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec4 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+// packed meshes store positions relative to their bounds, see rg::PackedVertex
+uniform vec3 quantizationOffset;
+uniform vec3 quantizationScale;
+
+// world to shadow map clip space of the cascade being drawn
+uniform mat4 lightSpace;
+
+void main()
+{
+    // placed in the world like the lit shaders place it: w is dropped, and the bottom row of
+    // the first column carries the LOD cross-fade
+    mat4 model = aInstanceModel;
+    model[0][3] = 0.0;
+    vec3 position = aPos.xyz * quantizationScale + quantizationOffset;
+    gl_Position = lightSpace * vec4(vec3(model * vec4(position, 1.0)), 1.0);
+}
\ No newline at end of file
@@ -1,20 +0,0 @@
-#version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoords;
-layout (location = 2) in vec3 aNormal;
-
-out vec2 TexCoords;
-out vec3 Normal;
-out vec3 FragPos;
-
-uniform mat4 model2;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    FragPos = vec3(model2 * vec4(aPos, 1.0));
-    Normal = aNormal;
-    TexCoords = aTexCoords;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include <rg/frustum.h>
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define RG_FRUSTUM_SSE 1
+#endif
+
+namespace rg
+{
+
+// Gribb/Hartmann: every plane is the sum or difference of the fourth row of
+// the clip matrix and one of the others.
+auto Frustum::fromMatrix(const glm::mat4& viewProjection) -> Frustum
+{
+      auto row = [&viewProjection](int i) {
+	    return glm::vec4(viewProjection[0][i], viewProjection[1][i],
+			     viewProjection[2][i], viewProjection[3][i]);
+      };
+      Frustum frustum;
+      frustum.planes[Left] = row(3) + row(0);
+      frustum.planes[Right] = row(3) - row(0);
+      frustum.planes[Bottom] = row(3) + row(1);
+      frustum.planes[Top] = row(3) - row(1);
+      frustum.planes[Near] = row(3) + row(2);
+      frustum.planes[Far] = row(3) - row(2);
+      for (glm::vec4& plane : frustum.planes) {
+	    plane /= glm::length(glm::vec3(plane));
+      }
+      return frustum;
+}
+
+auto Frustum::intersects(const AABB& box) const -> bool
+{
+      glm::vec3 center = box.center();
+      glm::vec3 extent = box.extent();
+      for (const glm::vec4& plane : planes) {
+	    glm::vec3 normal(plane);
+	    float distance = glm::dot(normal, center) + plane.w;
+	    float radius = glm::dot(glm::abs(normal), extent);
+	    if (distance + radius < 0.0F) {
+		  return false;
+	    }
+      }
+      return true;
+}
+
+auto Frustum::intersects(const BoundingSphere& sphere) const -> bool
+{
+      for (const glm::vec4& plane : planes) {
+	    if (glm::dot(glm::vec3(plane), sphere.center) + plane.w <
+		-sphere.radius) {
+		  return false;
+	    }
+      }
+      return true;
+}
+
+void AABBBatch::clear()
+{
+      m_count = 0;
+      m_centerX.clear();
+      m_centerY.clear();
+      m_centerZ.clear();
+      m_extentX.clear();
+      m_extentY.clear();
+      m_extentZ.clear();
+}
+
+auto AABBBatch::add(const AABB& box) -> std::size_t
+{
+      if (m_count % 4 == 0) {
+	    std::size_t padded = m_count + 4;
+	    m_centerX.resize(padded);
+	    m_centerY.resize(padded);
+	    m_centerZ.resize(padded);
+	    m_extentX.resize(padded);
+	    m_extentY.resize(padded);
+	    m_extentZ.resize(padded);
+      }
+      glm::vec3 center = box.center();
+      glm::vec3 extent = box.extent();
+      m_centerX[m_count] = center.x;
+      m_centerY[m_count] = center.y;
+      m_centerZ[m_count] = center.z;
+      m_extentX[m_count] = extent.x;
+      m_extentY[m_count] = extent.y;
+      m_extentZ[m_count] = extent.z;
+      return m_count++;
+}
+
+// A box is outside when, for some plane, the distance of its center plus its
+// projected radius |n| . extent is negative.
+void AABBBatch::cull(const Frustum& frustum,
+		     std::vector<std::uint8_t>& visible) const
+{
+      visible.resize(m_count);
+#ifdef RG_FRUSTUM_SSE
+      __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+      __m128 absX[6], absY[6], absZ[6];
+      for (int p = 0; p < 6; ++p) {
+	    const glm::vec4& plane = frustum.planes[p];
+	    planeX[p] = _mm_set1_ps(plane.x);
+	    planeY[p] = _mm_set1_ps(plane.y);
+	    planeZ[p] = _mm_set1_ps(plane.z);
+	    planeW[p] = _mm_set1_ps(plane.w);
+	    absX[p] = _mm_set1_ps(glm::abs(plane.x));
+	    absY[p] = _mm_set1_ps(glm::abs(plane.y));
+	    absZ[p] = _mm_set1_ps(glm::abs(plane.z));
+      }
+      const __m128 zero = _mm_setzero_ps();
+      for (std::size_t first = 0; first < m_count; first += 4) {
+	    __m128 cx = _mm_loadu_ps(&m_centerX[first]);
+	    __m128 cy = _mm_loadu_ps(&m_centerY[first]);
+	    __m128 cz = _mm_loadu_ps(&m_centerZ[first]);
+	    __m128 ex = _mm_loadu_ps(&m_extentX[first]);
+	    __m128 ey = _mm_loadu_ps(&m_extentY[first]);
+	    __m128 ez = _mm_loadu_ps(&m_extentZ[first]);
+	    __m128 outside = _mm_setzero_ps();
+	    for (int p = 0; p < 6; ++p) {
+		  __m128 distance = _mm_add_ps(
+		      _mm_add_ps(_mm_mul_ps(planeX[p], cx),
+				 _mm_mul_ps(planeY[p], cy)),
+		      _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+		  __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex),
+							_mm_mul_ps(absY[p], ey)),
+					     _mm_mul_ps(absZ[p], ez));
+		  outside = _mm_or_ps(
+		      outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+	    }
+	    int mask = _mm_movemask_ps(outside);
+	    std::size_t lanes = std::min<std::size_t>(4, m_count - first);
+	    for (std::size_t lane = 0; lane < lanes; ++lane) {
+		  visible[first + lane] = ((mask >> lane) & 1) == 0 ? 1 : 0;
+	    }
+      }
+#else
+      for (std::size_t i = 0; i < m_count; ++i) {
+	    glm::vec3 center(m_centerX[i], m_centerY[i], m_centerZ[i]);
+	    glm::vec3 extent(m_extentX[i], m_extentY[i], m_extentZ[i]);
+	    AABB box{center - extent, center + extent};
+	    visible[i] = frustum.intersects(box) ? 1 : 0;
+      }
+#endif
+}
+
+}  // namespace rg
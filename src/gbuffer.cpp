@@ -0,0 +1,86 @@
+#include <rg/gbuffer.h>
+
+#include <rg/service_locator.h>
+#include <rg/texture_type.h>
+
+#include <iostream>
+
+namespace rg
+{
+namespace
+{
+struct TargetFormat {
+      GLenum internalFormat;
+      GLenum format;
+      GLenum type;
+};
+
+constexpr TargetFormat TARGET_FORMATS[] = {
+    {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE},
+    {GL_RG16, GL_RG, GL_UNSIGNED_SHORT},
+    {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE},
+    {GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT},
+};
+
+constexpr unsigned int TARGET_UNITS[] = {
+    GBUFFER_ALBEDO_OCCLUSION_UNIT, GBUFFER_NORMAL_UNIT,
+    GBUFFER_MATERIAL_UNIT, GBUFFER_DEPTH_UNIT};
+}  // namespace
+
+GBuffer::GBuffer(unsigned int width, unsigned int height)
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      glGenFramebuffers(1, &m_FBO);
+      state.bindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+      glGenTextures(TARGET_COUNT, m_textures);
+      for (int i = 0; i < TARGET_COUNT; ++i) {
+	    const TargetFormat& target = TARGET_FORMATS[i];
+	    state.bindTexture(TARGET_UNITS[i], GL_TEXTURE_2D, m_textures[i]);
+	    glTexImage2D(GL_TEXTURE_2D, 0, target.internalFormat, width,
+			 height, 0, target.format, target.type, nullptr);
+	    // read with texelFetch, one texel per pixel
+	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	    GLenum attachment = i == Depth ? GL_DEPTH_ATTACHMENT
+					   : GL_COLOR_ATTACHMENT0 + i;
+	    glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D,
+				   m_textures[i], 0);
+      }
+      const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0,
+				    GL_COLOR_ATTACHMENT1,
+				    GL_COLOR_ATTACHMENT2};
+      glDrawBuffers(3, drawBuffers);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+	    std::cout << "ERROR::FRAMEBUFFER:: G-buffer is not complete!"
+		      << std::endl;
+      }
+      state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GBuffer::~GBuffer()
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      for (unsigned int texture : m_textures) {
+	    state.forgetTexture(texture);
+      }
+      glDeleteTextures(TARGET_COUNT, m_textures);
+      glDeleteFramebuffers(1, &m_FBO);
+}
+
+void GBuffer::bindForGeometry() const
+{
+      ServiceLocator::Get().getGLState().bindFramebuffer(GL_FRAMEBUFFER,
+							 m_FBO);
+      // pixels nothing covers keep depth 1, which the lighting pass skips
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::bindTextures() const
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      for (int i = 0; i < TARGET_COUNT; ++i) {
+	    state.bindTexture(TARGET_UNITS[i], GL_TEXTURE_2D, m_textures[i]);
+      }
+}
+
+}  // namespace rg
@@ -0,0 +1,167 @@
+#include <rg/geometry_pool.h>
+
+#include <rg/gl_extensions.h>
+#include <rg/service_locator.h>
+
+#include <algorithm>
+
+namespace rg
+{
+namespace
+{
+// the first allocation reserves room for a few typical meshes at once
+constexpr std::size_t MIN_ARENA_VERTICES = 1 << 16;
+constexpr std::size_t MIN_ARENA_INDICES = 1 << 18;
+
+auto indexSize(GLenum indexType) -> std::size_t
+{
+      return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort)
+					    : sizeof(GLuint);
+}
+
+// Replaces buffer with a larger one holding the same first usedBytes. The
+// copy stays on the GPU.
+void growBuffer(unsigned int& buffer, std::size_t usedBytes,
+		std::size_t capacityBytes)
+{
+      unsigned int grown = 0;
+      glGenBuffers(1, &grown);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+      glBufferData(GL_COPY_WRITE_BUFFER, capacityBytes, nullptr,
+		   GL_STATIC_DRAW);
+      if (buffer != 0) {
+	    if (usedBytes > 0) {
+		  glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		  glCopyBufferSubData(GL_COPY_READ_BUFFER,
+				      GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+	    }
+	    glDeleteBuffers(1, &buffer);
+      }
+      buffer = grown;
+}
+}  // namespace
+
+auto GeometryPool::allocate(AttributeSetup setupAttributes,
+			    const void* vertexData, std::size_t vertexCount,
+			    std::size_t vertexSize, const void* indexData,
+			    std::size_t indexCount, GLenum indexType)
+    -> GeometryRange
+{
+      Arena& arena = findArena(setupAttributes, vertexSize, indexType);
+      reserve(arena, arena.vertexCount + vertexCount,
+	      arena.indexCount + indexCount);
+
+      // the copy target leaves the VAO and its element array binding alone
+      glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vertexBuffer);
+      glBufferSubData(GL_COPY_WRITE_BUFFER, arena.vertexCount * vertexSize,
+		      vertexCount * vertexSize, vertexData);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, arena.indexBuffer);
+      glBufferSubData(GL_COPY_WRITE_BUFFER,
+		      arena.indexCount * indexSize(indexType),
+		      indexCount * indexSize(indexType), indexData);
+
+      GeometryRange range{arena.VAO, static_cast<int>(arena.vertexCount),
+			  static_cast<unsigned int>(arena.indexCount)};
+      arena.vertexCount += vertexCount;
+      arena.indexCount += indexCount;
+      return range;
+}
+
+void GeometryPool::multiDrawIndirect(
+    std::span<const DrawElementsIndirectCommand> commands, GLenum indexType)
+{
+      if (m_indirectBuffer == 0) {
+	    glGenBuffers(1, &m_indirectBuffer);
+      }
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+      // orphaned every time, like the instance buffer
+      glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size_bytes(),
+		   commands.data(), GL_STREAM_DRAW);
+      glExtensions().multiDrawElementsIndirect(
+	  GL_TRIANGLES, indexType, nullptr,
+	  static_cast<GLsizei>(commands.size()), 0);
+}
+
+auto GeometryPool::stats() const -> Stats
+{
+      Stats stats;
+      stats.arenas = m_arenas.size();
+      for (const Arena& arena : m_arenas) {
+	    stats.vertexBytes += arena.vertexCount * arena.vertexSize;
+	    stats.indexBytes += arena.indexCount * indexSize(arena.indexType);
+      }
+      return stats;
+}
+
+void GeometryPool::release()
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      for (Arena& arena : m_arenas) {
+	    state.forgetVertexArray(arena.VAO);
+	    glDeleteVertexArrays(1, &arena.VAO);
+	    glDeleteBuffers(1, &arena.vertexBuffer);
+	    glDeleteBuffers(1, &arena.indexBuffer);
+      }
+      m_arenas.clear();
+      if (m_indirectBuffer != 0) {
+	    glDeleteBuffers(1, &m_indirectBuffer);
+	    m_indirectBuffer = 0;
+      }
+}
+
+auto GeometryPool::findArena(AttributeSetup setupAttributes,
+			     std::size_t vertexSize, GLenum indexType) -> Arena&
+{
+      auto it = std::find_if(
+	  m_arenas.begin(), m_arenas.end(), [&](const Arena& arena) {
+		return arena.setupAttributes == setupAttributes &&
+		       arena.vertexSize == vertexSize &&
+		       arena.indexType == indexType;
+	  });
+      if (it != m_arenas.end()) {
+	    return *it;
+      }
+      Arena arena;
+      arena.setupAttributes = setupAttributes;
+      arena.vertexSize = vertexSize;
+      arena.indexType = indexType;
+      glGenVertexArrays(1, &arena.VAO);
+      m_arenas.push_back(arena);
+      return m_arenas.back();
+}
+
+void GeometryPool::reserve(Arena& arena, std::size_t vertexCount,
+			   std::size_t indexCount)
+{
+      if (vertexCount <= arena.vertexCapacity &&
+	  indexCount <= arena.indexCapacity) {
+	    return;
+      }
+      if (vertexCount > arena.vertexCapacity) {
+	    std::size_t capacity =
+		std::max({vertexCount, arena.vertexCapacity * 2,
+			  MIN_ARENA_VERTICES});
+	    growBuffer(arena.vertexBuffer, arena.vertexCount * arena.vertexSize,
+		       capacity * arena.vertexSize);
+	    arena.vertexCapacity = capacity;
+      }
+      if (indexCount > arena.indexCapacity) {
+	    std::size_t capacity =
+		std::max({indexCount, arena.indexCapacity * 2,
+			  MIN_ARENA_INDICES});
+	    growBuffer(arena.indexBuffer,
+		       arena.indexCount * indexSize(arena.indexType),
+		       capacity * indexSize(arena.indexType));
+	    arena.indexCapacity = capacity;
+      }
+
+      // the VAO still points at the buffers that were just replaced
+      GLState& state = ServiceLocator::Get().getGLState();
+      state.bindVertexArray(arena.VAO);
+      glBindBuffer(GL_ARRAY_BUFFER, arena.vertexBuffer);
+      arena.setupAttributes();
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indexBuffer);
+      state.bindVertexArray(0);
+}
+
+}  // namespace rg
@@ -0,0 +1,329 @@
+#include <rg/light_clusters.h>
+
+#include <rg/service_locator.h>
+#include <rg/texture_type.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define RG_CLUSTERS_SSE 1
+#endif
+
+namespace rg
+{
+namespace
+{
+enum Buffer { Grid, Indices, Lights };
+
+constexpr GLenum BUFFER_FORMATS[3] = {GL_RG32UI, GL_R16UI, GL_RGBA32F};
+constexpr unsigned int BUFFER_UNITS[3] = {
+    CLUSTER_GRID_UNIT, CLUSTER_LIGHT_INDICES_UNIT, POINT_LIGHTS_UNIT};
+// what GL 3.3 guarantees for GL_MAX_TEXTURE_BUFFER_SIZE
+constexpr GLint MIN_TEXTURE_BUFFER_TEXELS = 65536;
+// RGBA32F texels per PointLightData
+constexpr std::size_t LIGHT_TEXELS = sizeof(PointLightData) / 16;
+
+// Orphans the store of buffer and fills it, so the draws of the previous
+// frame keep reading the old lists.
+void upload(unsigned int buffer, const void* data, std::size_t size)
+{
+      glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+      // texture buffers may not be empty
+      glBufferData(GL_TEXTURE_BUFFER, std::max<std::size_t>(size, 16),
+		   nullptr, GL_STREAM_DRAW);
+      if (size != 0) {
+	    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+      }
+}
+
+#ifdef RG_CLUSTERS_SSE
+// Distance from point to four boxes along one axis, max(|center - point| -
+// extent, 0).
+auto axisDistance(const float* center, const float* extent, __m128 point)
+    -> __m128
+{
+      __m128 offset = _mm_sub_ps(_mm_loadu_ps(center), point);
+      // clearing the sign bit is the absolute value
+      offset = _mm_andnot_ps(_mm_set1_ps(-0.0F), offset);
+      return _mm_max_ps(_mm_sub_ps(offset, _mm_loadu_ps(extent)),
+			_mm_setzero_ps());
+}
+#endif
+}  // namespace
+
+// Solves constant + linear d + quadratic d^2 = brightest / threshold for d.
+auto pointLightRadius(const PointLightData& light, float threshold) -> float
+{
+      glm::vec3 brightest =
+	  glm::max(light.ambient, glm::max(light.diffuse, light.specular));
+      float intensity = std::max({brightest.r, brightest.g, brightest.b});
+      float c = light.constant - intensity / threshold;
+      if (c >= 0.0F) {
+	    return 0.0F;
+      }
+      if (light.quadratic <= 0.0F) {
+	    return light.linear > 0.0F ? -c / light.linear : INFINITY;
+      }
+      float discriminant = light.linear * light.linear -
+			   4.0F * light.quadratic * c;
+      return (-light.linear + std::sqrt(discriminant)) /
+	     (2.0F * light.quadratic);
+}
+
+LightClusters::LightClusters(unsigned int gridX, unsigned int gridY,
+			     unsigned int gridZ)
+    : m_gridX(gridX), m_gridY(gridY), m_gridZ(gridZ), m_slices(gridZ)
+{
+      std::size_t clusters = std::size_t(gridX) * gridY * gridZ;
+      m_clusterLights.resize(clusters * MAX_LIGHTS_PER_CLUSTER);
+      m_counts.resize(clusters);
+      m_dropped.resize(gridZ);
+      m_grid.resize(clusters * 2);
+      m_block.gridSize = glm::uvec4(gridX, gridY, gridZ, 0);
+
+      GLint maxTexels = 0;
+      glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+      maxTexels = std::max(maxTexels, MIN_TEXTURE_BUFFER_TEXELS);
+      m_maxLights = std::min(MAX_LIGHTS, std::size_t(maxTexels) / LIGHT_TEXELS);
+      m_maxIndices = std::size_t(maxTexels);
+
+      GLState& state = ServiceLocator::Get().getGLState();
+      glGenBuffers(3, m_buffers);
+      glGenTextures(3, m_textures);
+      for (int i = 0; i < 3; ++i) {
+	    upload(m_buffers[i], nullptr, 0);
+	    state.bindTexture(BUFFER_UNITS[i], GL_TEXTURE_BUFFER,
+			      m_textures[i]);
+	    glTexBuffer(GL_TEXTURE_BUFFER, BUFFER_FORMATS[i], m_buffers[i]);
+      }
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::~LightClusters()
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      for (unsigned int texture : m_textures) {
+	    state.forgetTexture(texture);
+      }
+      glDeleteTextures(3, m_textures);
+      glDeleteBuffers(3, m_buffers);
+}
+
+void LightClusters::setProjection(float fovY, float aspect, float near,
+				  float far, float width, float height)
+{
+      if (fovY == m_fovY && aspect == m_aspect && near == m_near &&
+	  far == m_far && width == m_width && height == m_height) {
+	    return;
+      }
+      m_fovY = fovY;
+      m_aspect = aspect;
+      m_near = near;
+      m_far = far;
+      m_width = width;
+      m_height = height;
+
+      float logRange = std::log(far / near);
+      m_block.tilePixels = glm::vec2(width / (float)m_gridX,
+				     height / (float)m_gridY);
+      m_block.sliceScale = (float)m_gridZ / logRange;
+      m_block.sliceBias = -(float)m_gridZ * std::log(near) / logRange;
+      m_clusterData.update(m_block);
+      buildSlices();
+}
+
+// Slice z spans view depths near (far / near)^(z / gridZ) to the next one,
+// the inverse of what the shaders compute from sliceScale and sliceBias. A
+// cluster box bounds its tile of the window over both ends of the slice.
+void LightClusters::buildSlices()
+{
+      float tanY = std::tan(m_fovY * 0.5F);
+      float tanX = tanY * m_aspect;
+      std::size_t tiles = std::size_t(m_gridX) * m_gridY;
+      std::size_t padded = (tiles + 3) & ~std::size_t(3);
+      for (unsigned int z = 0; z < m_gridZ; ++z) {
+	    Slice& slice = m_slices[z];
+	    slice.near = m_near * std::pow(m_far / m_near,
+					   (float)z / (float)m_gridZ);
+	    slice.far = m_near * std::pow(m_far / m_near,
+					  (float)(z + 1) / (float)m_gridZ);
+	    for (std::vector<float>* array :
+		 {&slice.centerX, &slice.centerY, &slice.centerZ,
+		  &slice.extentX, &slice.extentY, &slice.extentZ}) {
+		  // padding lanes are far away and never hit
+		  array->assign(padded, 0.0F);
+	    }
+	    for (std::size_t tile = tiles; tile < padded; ++tile) {
+		  slice.centerZ[tile] = INFINITY;
+	    }
+	    for (unsigned int y = 0; y < m_gridY; ++y) {
+		  float y0 = -1.0F + 2.0F * (float)y / (float)m_gridY;
+		  float y1 = -1.0F + 2.0F * (float)(y + 1) / (float)m_gridY;
+		  for (unsigned int x = 0; x < m_gridX; ++x) {
+			float x0 = -1.0F + 2.0F * (float)x / (float)m_gridX;
+			float x1 =
+			    -1.0F + 2.0F * (float)(x + 1) / (float)m_gridX;
+			// the tile corners at either end of the slice; view
+			// space looks down -z
+			glm::vec3 scale(tanX, tanY, 1.0F);
+			glm::vec3 low =
+			    scale * glm::vec3(std::min(x0 * slice.near,
+						       x0 * slice.far),
+					      std::min(y0 * slice.near,
+						       y0 * slice.far),
+					      -slice.far);
+			glm::vec3 high =
+			    scale * glm::vec3(std::max(x1 * slice.near,
+						       x1 * slice.far),
+					      std::max(y1 * slice.near,
+						       y1 * slice.far),
+					      -slice.near);
+			glm::vec3 center = (low + high) * 0.5F;
+			glm::vec3 extent = (high - low) * 0.5F;
+			std::size_t tile = std::size_t(y) * m_gridX + x;
+			slice.centerX[tile] = center.x;
+			slice.centerY[tile] = center.y;
+			slice.centerZ[tile] = center.z;
+			slice.extentX[tile] = extent.x;
+			slice.extentY[tile] = extent.y;
+			slice.extentZ[tile] = extent.z;
+		  }
+	    }
+      }
+}
+
+void LightClusters::update(const glm::mat4& view,
+			   std::span<const PointLightData> lights)
+{
+      auto start = std::chrono::steady_clock::now();
+      std::size_t submitted = lights.size();
+      lights = lights.first(std::min(lights.size(), m_maxLights));
+      m_viewLights.clear();
+      for (const PointLightData& light : lights) {
+	    m_viewLights.emplace_back(
+		glm::vec3(view * glm::vec4(light.position, 1.0F)),
+		light.radius);
+      }
+
+      std::fill(m_counts.begin(), m_counts.end(), 0U);
+      std::fill(m_dropped.begin(), m_dropped.end(), 0U);
+      if (!m_viewLights.empty() && m_far > m_near) {
+	    ServiceLocator::Get().getThreadPool().parallelFor(
+		m_gridZ, [this](std::size_t z) {
+		      assignSlice(static_cast<unsigned int>(z));
+		});
+      }
+
+      m_stats = Stats{};
+      m_stats.lights = submitted;
+      m_stats.dropped = submitted - lights.size();
+      m_indices.clear();
+      for (std::size_t cluster = 0; cluster < m_counts.size(); ++cluster) {
+	    // the clusters past a full index buffer lose their lights
+	    auto count = static_cast<unsigned int>(std::min<std::size_t>(
+		m_counts[cluster], m_maxIndices - m_indices.size()));
+	    m_stats.dropped += m_counts[cluster] - count;
+	    const std::uint16_t* first =
+		&m_clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+	    m_grid[cluster * 2] = m_indices.size();
+	    m_grid[cluster * 2 + 1] = count;
+	    m_indices.insert(m_indices.end(), first, first + count);
+	    m_stats.maxPerCluster = std::max(m_stats.maxPerCluster, count);
+      }
+      m_stats.references = m_indices.size();
+      for (unsigned int dropped : m_dropped) {
+	    m_stats.dropped += dropped;
+      }
+
+      upload(m_buffers[Grid], m_grid.data(),
+	     m_grid.size() * sizeof(std::uint32_t));
+      upload(m_buffers[Indices], m_indices.data(),
+	     m_indices.size() * sizeof(std::uint16_t));
+      upload(m_buffers[Lights], lights.data(),
+	     lights.size() * sizeof(PointLightData));
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+      m_stats.assignMilliseconds =
+	  std::chrono::duration<double, std::milli>(
+	      std::chrono::steady_clock::now() - start)
+	      .count();
+}
+
+void LightClusters::bind() const
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      for (int i = 0; i < 3; ++i) {
+	    state.bindTexture(BUFFER_UNITS[i], GL_TEXTURE_BUFFER,
+			      m_textures[i]);
+      }
+}
+
+// Runs on a worker; slices own disjoint clusters, so nothing is shared. A
+// sphere reaches a box when the distance from its center to the box,
+// per axis max(|center - box center| - extent, 0), is below its radius.
+void LightClusters::assignSlice(unsigned int z)
+{
+      const Slice& slice = m_slices[z];
+      std::size_t tiles = std::size_t(m_gridX) * m_gridY;
+      std::size_t firstCluster = std::size_t(z) * tiles;
+      auto add = [&](std::size_t tile, std::size_t light) {
+	    unsigned int& count = m_counts[firstCluster + tile];
+	    if (count == MAX_LIGHTS_PER_CLUSTER) {
+		  ++m_dropped[z];
+		  return;
+	    }
+	    m_clusterLights[(firstCluster + tile) * MAX_LIGHTS_PER_CLUSTER +
+			    count] = static_cast<std::uint16_t>(light);
+	    ++count;
+      };
+
+      for (std::size_t light = 0; light < m_viewLights.size(); ++light) {
+	    const glm::vec4& sphere = m_viewLights[light];
+	    float depth = -sphere.z;
+	    if (depth + sphere.w < slice.near || depth - sphere.w > slice.far) {
+		  continue;
+	    }
+#ifdef RG_CLUSTERS_SSE
+	    const __m128 x = _mm_set1_ps(sphere.x);
+	    const __m128 y = _mm_set1_ps(sphere.y);
+	    const __m128 z4 = _mm_set1_ps(sphere.z);
+	    const __m128 radius2 = _mm_set1_ps(sphere.w * sphere.w);
+	    for (std::size_t first = 0; first < tiles; first += 4) {
+		  __m128 dx = axisDistance(&slice.centerX[first],
+					   &slice.extentX[first], x);
+		  __m128 dy = axisDistance(&slice.centerY[first],
+					   &slice.extentY[first], y);
+		  __m128 dz = axisDistance(&slice.centerZ[first],
+					   &slice.extentZ[first], z4);
+		  __m128 distance2 = _mm_add_ps(
+		      _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+		      _mm_mul_ps(dz, dz));
+		  auto mask = static_cast<unsigned int>(
+		      _mm_movemask_ps(_mm_cmple_ps(distance2, radius2)));
+		  for (; mask != 0; mask &= mask - 1) {
+			std::size_t tile = first + std::countr_zero(mask);
+			if (tile < tiles) {
+			      add(tile, light);
+			}
+		  }
+	    }
+#else
+	    for (std::size_t tile = 0; tile < tiles; ++tile) {
+		  glm::vec3 center(slice.centerX[tile], slice.centerY[tile],
+				   slice.centerZ[tile]);
+		  glm::vec3 extent(slice.extentX[tile], slice.extentY[tile],
+				   slice.extentZ[tile]);
+		  glm::vec3 d = glm::max(
+		      glm::abs(center - glm::vec3(sphere)) - extent, 0.0F);
+		  if (glm::dot(d, d) <= sphere.w * sphere.w) {
+			add(tile, light);
+		  }
+	    }
+#endif
+      }
+}
+
+}  // namespace rg
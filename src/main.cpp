@@ -4,12 +4,25 @@
 #include <learnopengl/model.h>
 #include <learnopengl/shader.h>
 #include <rg/Camera.h>
+#include <rg/gbuffer.h>
+#include <rg/gl_extensions.h>
+#include <rg/light_clusters.h>
+#include <rg/material.h>
+#include <rg/mesh_optimizer.h>
+#include <rg/render_queue.h>
+#include <rg/scene_bvh.h>
 #include <rg/service_locator.h>
+#include <rg/shader_library.h>
+#include <rg/shader_variants.h>
+#include <rg/shadow_cascades.h>
+#include <rg/uniform_buffer.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <numeric>
+#include <utility>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -20,19 +33,35 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
 
+void mouse_button_callback(GLFWwindow *window, int button, int action,
+			   int mods);
+
 void processInput(GLFWwindow *window);
 
+void RunScene(GLFWwindow *window);
+
 void key_callback(GLFWwindow *window, int key, int scancode, int action,
 		  int mods);
 
-auto loadTexture(char const *path) -> unsigned int;
+auto loadTexture(char const *path,
+		 rg::TextureUsage usage = rg::TextureUsage::Color)
+    -> unsigned int;
 
-void renderQuad();
+auto SequentialIndices(std::size_t count) -> vector<unsigned int>;
+
+auto CreatePlaneMesh(unsigned int diffuseMap, unsigned int normalMap,
+		     unsigned int heightMap) -> Mesh;
 
 // settings
 const unsigned int SCR_WIDTH = 1000;
 const unsigned int SCR_HEIGHT = 800;
 
+// view depth the directional light's shadows reach
+const float SHADOW_DISTANCE = 30.0F;
+
+// texture levels streamed in per frame, in bytes
+const std::size_t TEXTURE_UPLOAD_BUDGET = 8 << 20;
+
 // camera
 
 float lastX = SCR_WIDTH / 2.0F;
@@ -77,6 +106,10 @@ struct ProgramState {
       bool Blinn = true;
       bool pointLightInd = true;
       bool grayScaleInd = false;
+      // opaque meshes go through the G-buffer and are lit in one pass
+      bool deferredShading = false;
+      bool shadows = true;
+      int shadowCascadeCount = 3;
 
       float plantScale = 0.1F;
       float tableScale = 5.0F;
@@ -84,6 +117,14 @@ struct ProgramState {
 
       PointLight pointLight;
       DirLight dirLight;
+      // index into the scene objects, picked with the left mouse button
+      int selectedObject = -1;
+      // largest simplification error of a LOD, in pixels, before a finer one
+      // is drawn
+      float lodPixelError = 1.0F;
+      // small colored lights scattered around the scene besides pointLight;
+      // none unless added from the stats window
+      int smallLightCount = 0;
       ProgramState() : camera(glm::vec3(0.0F, 0.0F, 1.0F)) {}
 
       void SaveToFile(std::string filename) const;
@@ -132,15 +173,103 @@ void ProgramState::LoadFromFile(std::string filename)
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+// one mesh placed in the world; the scene BVH and the render queue work on these
+struct SceneObject {
+      std::string name;
+      // drawn with the material of the mesh, which picks the program
+      Mesh *mesh;
+      rg::RenderPass pass;
+      rg::ShadowCaster caster;
+      const glm::mat4 *model;
+      // edited in the ImGui window when the object is picked, may be null
+      glm::vec3 *position;
+};
+
+// world space ray through the cursor position
+auto MouseRay(GLFWwindow *window, const glm::mat4 &projection,
+	      const glm::mat4 &view) -> rg::Ray;
+
+// packs the scene lights into the std140 layout of the Lights uniform block
+auto MakeLightsBlock(const ProgramState *programState) -> rg::LightsBlock
+{
+      const PointLight &pointLight = programState->pointLight;
+      const DirLight &dirLight = programState->dirLight;
+      rg::LightsBlock block{};
+      block.dirLight.direction = dirLight.direction;
+      block.dirLight.ambient = dirLight.ambient;
+      block.dirLight.diffuse = dirLight.diffuse;
+      block.dirLight.specular = dirLight.specular;
+      block.pointLight.position = pointLight.position;
+      // the lighting shaders read every point light from the clusters, see
+      // MakeSceneLights; the block keeps the first one for the plane
+      if (programState->pointLightInd) {
+	    block.pointLight.ambient = pointLight.ambient;
+	    block.pointLight.diffuse = pointLight.diffuse;
+	    block.pointLight.specular = pointLight.specular;
+      }
+      block.pointLight.constant = pointLight.constant;
+      block.pointLight.linear = pointLight.linear;
+      block.pointLight.quadratic = pointLight.quadratic;
+      return block;
+}
+
+// the point lights of the scene at time: pointLight first, then the small
+// ones circling the middle of the scene; none when point lights are off
+void MakeSceneLights(const ProgramState *programState, float time,
+		     vector<rg::PointLightData> &lights)
+{
+      lights.clear();
+      if (!programState->pointLightInd) {
+	    return;
+      }
+      const PointLight &pointLight = programState->pointLight;
+      rg::PointLightData light{};
+      light.position = pointLight.position;
+      light.ambient = pointLight.ambient;
+      light.diffuse = pointLight.diffuse;
+      light.specular = pointLight.specular;
+      light.constant = pointLight.constant;
+      light.linear = pointLight.linear;
+      light.quadratic = pointLight.quadratic;
+      light.radius = rg::pointLightRadius(light);
+      lights.push_back(light);
+
+      // a sunflower spiral spreads any number of them evenly over a disc
+      int count = programState->smallLightCount;
+      for (int i = 0; i < count; ++i) {
+	    float angle = (float)i * 2.39996F + time * 0.2F;
+	    float distance = 7.0F * std::sqrt(((float)i + 0.5F) / (float)count);
+	    float hue = std::fmod((float)i * 0.618034F, 1.0F);
+	    glm::vec3 color =
+		0.5F + 0.5F * glm::cos(6.28318F * (glm::vec3(hue) +
+						    glm::vec3(0.0F, 0.33F,
+							      0.67F)));
+	    light.position =
+		glm::vec3(distance * std::cos(angle),
+			  -1.0F + 0.3F * std::sin(time * 1.5F + (float)i),
+			  distance * std::sin(angle));
+	    light.ambient = glm::vec3(0.0F);
+	    light.diffuse = color * 0.8F;
+	    light.specular = color * 0.5F;
+	    light.constant = 1.0F;
+	    light.linear = 0.7F;
+	    light.quadratic = 1.8F;
+	    light.radius = rg::pointLightRadius(light);
+	    lights.push_back(light);
+      }
+}
+
+void DrawImGui(ProgramState *programState,
+	       const rg::RenderQueue::FrameStats &renderQueueStats,
+	       const rg::LightClusters::Stats &lightClusterStats,
+	       const rg::ShadowCascades::Stats &shadowStats,
+	       const SceneObject *selectedObject);
 
 auto main() -> int
 {
       // glfw: initialize and configure
       // ------------------------------
       glfwInit();
-      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
       glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
       // glfwWindowHint(GLFW_SAMPLES, 4);
 
@@ -150,8 +279,18 @@ auto main() -> int
 
       // glfw window creation
       // --------------------
-      GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT,
-					    "LearnOpenGL", nullptr, nullptr);
+      // 4.3 enables multi draw indirect in the render queue, everything else
+      // runs on 3.3
+      GLFWwindow *window = nullptr;
+      for (auto [major, minor] : {std::pair{4, 3}, std::pair{3, 3}}) {
+	    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+	    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+	    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL",
+				      nullptr, nullptr);
+	    if (window != nullptr) {
+		  break;
+	    }
+      }
       if (window == nullptr) {
 	    std::cout << "Failed to create GLFW window" << std::endl;
 	    glfwTerminate();
@@ -162,6 +301,7 @@ auto main() -> int
       glfwSetCursorPosCallback(window, mouse_callback);
       glfwSetScrollCallback(window, scroll_callback);
       glfwSetKeyCallback(window, key_callback);
+      glfwSetMouseButtonCallback(window, mouse_button_callback);
 
       // tell GLFW to capture our mouse
       //    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -172,6 +312,8 @@ auto main() -> int
 	    std::cout << "Failed to initialize GLAD" << std::endl;
 	    return -1;
       }
+      // multi draw indirect and friends when the context is newer than 3.3
+      rg::loadGLExtensions((GLADloadproc)glfwGetProcAddress);
 
       // tell stb_image.h to flip loaded texture's on the y-axis (before loading
       // model).
@@ -193,22 +335,83 @@ auto main() -> int
 
       // configure global opengl state
       // -----------------------------
-      glEnable(GL_DEPTH_TEST);
+      // binds and enables go through the state cache so redundant ones are dropped
+      rg::GLState &glState = rg::ServiceLocator::Get().getGLState();
+      glState.enable(GL_DEPTH_TEST);
+      // only enabled for the transparent pass of the render queue
+      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+      // the scene's GL objects are deleted when RunScene returns, while the
+      // context is still current
+      RunScene(window);
+
+      programState->SaveToFile("resources/program_state.txt");
+      delete programState;
+      ImGui_ImplOpenGL3_Shutdown();
+      ImGui_ImplGlfw_Shutdown();
+      ImGui::DestroyContext();
+
+      rg::ServiceLocator::Get().getGeometryPool().release();
+      rg::ServiceLocator::Get().getTextureLoader().release();
+      // glfw: terminate, clearing all previously allocated GLFW resources.
+      // ------------------------------------------------------------------
+      glfwTerminate();
+      return 0;
+}
+
+// loads the scene and renders it until the window is closed
+void RunScene(GLFWwindow *window)
+{
+      rg::GLState &glState = rg::ServiceLocator::Get().getGLState();
+
+      // the models import on the thread pool while the rest of the scene is
+      // set up; only their GL objects wait for Get below
+      PendingModel ourModelLoad =
+	  Model::LoadAsync("resources/objects/rock/potted_plant_obj.obj");
+      PendingModel tableModelLoad =
+	  Model::LoadAsync("resources/objects/table/table.obj");
 
       // build and compile shaders
       // -------------------------
-      Shader ourShader("resources/shaders/2.model_lighting.vs",
-		       "resources/shaders/2.model_lighting.fs");
-      Shader tableShader("resources/shaders/table.vs",
-			 "resources/shaders/table.fs");
-      Shader cubeShader("resources/shaders/lightCube.vs",
-			"resources/shaders/lightCube.fs");
-      Shader shader("resources/shaders/blending.vs",
-		    "resources/shaders/blending.fs");
-      Shader screenShader("resources/shaders/screen.vs",
-			  "resources/shaders/screen.fs");
-      Shader planeShader("resources/shaders/plane.vs",
-			 "resources/shaders/plane.fs");
+      // every program goes to the driver now and compiles while the rest
+      // of the scene loads; draws wait for their program to be ready
+      rg::ShaderLibrary shaderLibrary;
+      // the lighting programs are compiled per feature set on first use and
+      // shared by the materials of both models
+      rg::ShaderVariants lightingShaders(
+	  shaderLibrary, "resources/shaders/2.model_lighting.vs",
+	  "resources/shaders/2.model_lighting.fs");
+      // the same lighting, read back from the G-buffer over a screen quad
+      rg::ShaderVariants deferredLightingShaders(
+	  shaderLibrary, "resources/shaders/screen.vs",
+	  "resources/shaders/2.model_lighting.fs",
+	  rg::ShaderFeature::Blinn | rg::ShaderFeature::PointLight |
+	      rg::ShaderFeature::DeferredLighting |
+	      rg::ShaderFeature::Shadows);
+      rg::ShaderLibrary::Handle cubeProgram = shaderLibrary.add(
+	  "resources/shaders/lightCube.vs", "resources/shaders/lightCube.fs");
+      rg::ShaderLibrary::Handle blendingProgram = shaderLibrary.add(
+	  "resources/shaders/blending.vs", "resources/shaders/blending.fs");
+      rg::ShaderLibrary::Handle screenProgram = shaderLibrary.add(
+	  "resources/shaders/screen.vs", "resources/shaders/screen.fs");
+      // the plane shades like the lighting shaders, forward or into the
+      // G-buffer
+      rg::ShaderVariants planeShaders(
+	  shaderLibrary, "resources/shaders/plane.vs",
+	  "resources/shaders/plane.fs",
+	  rg::ShaderFeature::Blinn | rg::ShaderFeature::PointLight |
+	      rg::ShaderFeature::GBuffer | rg::ShaderFeature::Shadows);
+      rg::ShaderLibrary::Handle shadowProgram =
+	  shaderLibrary.add("resources/shaders/shadow_depth.vs",
+			    "resources/shaders/shadow_depth.fs");
+
+      // camera and light data shared by every program, uploaded once per frame
+      rg::UniformBuffer<rg::FrameDataBlock> frameDataBuffer(
+	  rg::FRAME_DATA_BINDING);
+      rg::UniformBuffer<rg::LightsBlock> lightsBuffer(rg::LIGHTS_BINDING);
+      // the point lights reach the lighting shaders through the clusters
+      rg::LightClusters lightClusters;
+      vector<rg::PointLightData> sceneLights;
 
       float cubeVertices[] = {
 	  -0.5F, -0.5F, -0.5F, 0.5F,  -0.5F, -0.5F, 0.5F,  0.5F,  -0.5F,
@@ -246,36 +449,6 @@ auto main() -> int
 			      -1.0F, 1.0F, 0.0F, 1.0F,	1.0F,  -1.0F,
 			      1.0F,  0.0F, 1.0F, 1.0F,	1.0F,  1.0F};
 
-      // light cube
-      unsigned int VAO;
-      unsigned int VBO;
-      glGenVertexArrays(1, &VAO);
-      glGenBuffers(1, &VBO);
-      glBindVertexArray(VAO);
-      glBindBuffer(GL_ARRAY_BUFFER, VBO);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices,
-		   GL_STATIC_DRAW);
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float),
-			    (void *)nullptr);
-
-      // transparent VAO
-      unsigned int transparentVAO;
-      unsigned int transparentVBO;
-      glGenVertexArrays(1, &transparentVAO);
-      glGenBuffers(1, &transparentVBO);
-      glBindVertexArray(transparentVAO);
-      glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
-      glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices),
-		   transparentVertices, GL_STATIC_DRAW);
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-			    (void *)nullptr);
-      glEnableVertexAttribArray(1);
-      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-			    (void *)(3 * sizeof(float)));
-      glBindVertexArray(0);
-
       vector<glm::vec3> vegetation{
 	  glm::vec3(-1.5F, -1.6F, -0.48F), glm::vec3(1.5F, -1.6F, 0.51F),
 	  glm::vec3(-3.0F, -1.6F, 0.7F),   glm::vec3(-0.3F, -1.6F, -2.3F),
@@ -292,29 +465,73 @@ auto main() -> int
 	  glm::vec3(4.5F, -1.6F, -3.0F),   glm::vec3(5.5F, -1.6F, -6.0F),
       };
 
+      // the vegetation never moves, so its model matrices are built once
+      vector<glm::mat4> vegetationModels;
+      vegetationModels.reserve(vegetation.size());
+      for (auto i : vegetation) {
+	    vegetationModels.push_back(glm::translate(glm::mat4(1.0F), i));
+      }
+
       // loading textures
       unsigned int transparentTexture =
 	  loadTexture("resources/textures/grass.png");
 
       unsigned int diffuseMap = loadTexture("resources/textures/ground.jpg");
-      unsigned int normalMap =
-	  loadTexture("resources/textures/ground_normal.jpg");
-      unsigned int heightMap =
-	  loadTexture("resources/textures/ground_disp.png");
-
-      shader.use();
-      shader.setInt("texture1", 0);
-      planeShader.use();
-      planeShader.setInt("diffuseMap", 0);
-      planeShader.setInt("normalMap", 1);
-      planeShader.setInt("depthMap", 2);
+      unsigned int normalMap = loadTexture(
+	  "resources/textures/ground_normal.jpg", rg::TextureUsage::Normal);
+      unsigned int heightMap = loadTexture("resources/textures/ground_disp.png",
+					   rg::TextureUsage::Height);
+
+      // scene meshes; each is drawn with a material of its textures
+      vector<Vertex> lightCubeVertices;
+      for (std::size_t i = 0; i + 2 < std::size(cubeVertices); i += 3) {
+	    Vertex vertex{};
+	    vertex.Position = glm::vec3(cubeVertices[i], cubeVertices[i + 1],
+					cubeVertices[i + 2]);
+	    lightCubeVertices.push_back(vertex);
+      }
+      Mesh lightCube(lightCubeVertices,
+		     SequentialIndices(lightCubeVertices.size()), {});
+
+      vector<Vertex> grassVertices;
+      for (std::size_t i = 0; i + 4 < std::size(transparentVertices);
+	   i += 5) {
+	    Vertex vertex{};
+	    vertex.Position = glm::vec3(transparentVertices[i],
+					transparentVertices[i + 1],
+					transparentVertices[i + 2]);
+	    vertex.TexCoords = glm::vec2(transparentVertices[i + 3],
+					 transparentVertices[i + 4]);
+	    grassVertices.push_back(vertex);
+      }
+      Mesh grassQuad(
+	  grassVertices, SequentialIndices(grassVertices.size()),
+	  {Texture{transparentTexture, rg::TextureType::Diffuse, "grass.png"}});
+
+      Mesh plane = CreatePlaneMesh(diffuseMap, normalMap, heightMap);
+
+      rg::Material lightCubeMaterial(shaderLibrary, cubeProgram, {});
+      lightCube.material = &lightCubeMaterial;
+      rg::Material grassMaterial(shaderLibrary, blendingProgram,
+				 grassQuad.textures);
+      grassQuad.material = &grassMaterial;
+      rg::Material planeMaterial(planeShaders, plane.textures);
+      plane.material = &planeMaterial;
+
+      rg::RenderQueue renderQueue;
+      // the opaque meshes drawn into the G-buffer in deferred shading
+      rg::RenderQueue gbufferQueue;
+      rg::GBuffer gBuffer(SCR_WIDTH, SCR_HEIGHT);
+      rg::ShadowCascades shadowCascades;
+      // the casters of one cascade at a time
+      rg::RenderQueue shadowQueue;
 
       // setup screen VAO
       unsigned int quadVAO;
       unsigned int quadVBO;
       glGenVertexArrays(1, &quadVAO);
       glGenBuffers(1, &quadVBO);
-      glBindVertexArray(quadVAO);
+      glState.bindVertexArray(quadVAO);
       glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
       glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
 		   GL_STATIC_DRAW);
@@ -328,14 +545,15 @@ auto main() -> int
       // MSAA framebuffer
       unsigned int framebuffer;
       glGenFramebuffers(1, &framebuffer);
-      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+      glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
       unsigned int textureColorBufferMultiSampled;
       glGenTextures(1, &textureColorBufferMultiSampled);
-      glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, textureColorBufferMultiSampled);
+      glState.bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE,
+			  textureColorBufferMultiSampled);
       glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, SCR_WIDTH,
 			      SCR_HEIGHT, GL_TRUE);
-      glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+      glState.bindTexture(0, GL_TEXTURE_2D_MULTISAMPLE, 0);
       glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
 			     GL_TEXTURE_2D_MULTISAMPLE,
 			     textureColorBufferMultiSampled, 0);
@@ -354,16 +572,16 @@ auto main() -> int
 	    cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << endl;
       }
       // deactivate framebuffer
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
       // configure second post-processing framebuffer
       unsigned int intermediateFBO;
       glGenFramebuffers(1, &intermediateFBO);
-      glBindFramebuffer(GL_FRAMEBUFFER, intermediateFBO);
+      glState.bindFramebuffer(GL_FRAMEBUFFER, intermediateFBO);
 
       unsigned int screenTexture;
       glGenTextures(1, &screenTexture);
-      glBindTexture(GL_TEXTURE_2D, screenTexture);
+      glState.bindTexture(0, GL_TEXTURE_2D, screenTexture);
       glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB,
 		   GL_UNSIGNED_BYTE, nullptr);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -376,15 +594,15 @@ auto main() -> int
 		    "complete!"
 		 << endl;
       }
-      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
 
       // load models
       // -----------
-      Model ourModel("resources/objects/rock/potted_plant_obj.obj");
-      ourModel.SetShaderTextureNamePrefix("material.");
+      Model ourModel = ourModelLoad.Get();
+      ourModel.CreateMaterials(lightingShaders);
 
-      Model tableModel("resources/objects/table/table.obj");
-      tableModel.SetShaderTextureNamePrefix("material.");
+      Model tableModel = tableModelLoad.Get();
+      tableModel.CreateMaterials(lightingShaders);
 
       PointLight &pointLight = programState->pointLight;
       pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
@@ -402,6 +620,66 @@ auto main() -> int
       dirLight.diffuse = glm::vec3(0.2F, 0.2F, 0.2F);
       dirLight.specular = glm::vec3(0.3F, 0.3F, 0.3F);
 
+      // scene objects; the transforms they point at are updated every frame
+      glm::mat4 lightCubeModel(1.0F);
+      glm::mat4 plantModel(1.0F);
+      glm::mat4 tableModelMatrix(1.0F);
+      glm::mat4 planeModel(1.0F);
+      vector<SceneObject> sceneObjects;
+      // the light cube orbits, so its shadow is drawn every frame; the
+      // static casters are cached until they are moved
+      sceneObjects.push_back({"Light cube", &lightCube,
+			      rg::RenderPass::Opaque,
+			      rg::ShadowCaster::Dynamic, &lightCubeModel,
+			      nullptr});
+      for (Mesh &mesh : ourModel.meshes) {
+	    sceneObjects.push_back({"Plant", &mesh, rg::RenderPass::Opaque,
+				    rg::ShadowCaster::Static, &plantModel,
+				    &programState->plantPosition});
+      }
+      for (Mesh &mesh : tableModel.meshes) {
+	    sceneObjects.push_back({"Table", &mesh, rg::RenderPass::Opaque,
+				    rg::ShadowCaster::Static,
+				    &tableModelMatrix,
+				    &programState->tablePosition});
+      }
+      sceneObjects.push_back({"Plane", &plane, rg::RenderPass::Opaque,
+			      rg::ShadowCaster::Static, &planeModel,
+			      &programState->planePosition});
+      for (const glm::mat4 &vegetationModel : vegetationModels) {
+	    sceneObjects.push_back({"Grass", &grassQuad,
+				    rg::RenderPass::Transparent,
+				    rg::ShadowCaster::None, &vegetationModel,
+				    nullptr});
+      }
+
+      // the BVH is built once and refitted as objects move
+      vector<rg::AABB> objectBounds(sceneObjects.size());
+      rg::SceneBVH sceneBVH;
+      for (std::size_t i = 0; i < sceneObjects.size(); ++i) {
+	    objectBounds[i] = rg::transform(sceneObjects[i].mesh->bounds,
+					    *sceneObjects[i].model);
+      }
+      sceneBVH.build(objectBounds);
+      vector<std::uint32_t> visibleObjects;
+      vector<rg::LodTransition> lodTransitions(sceneObjects.size());
+      // bumped whenever a static caster moves, which stales the shadow cache
+      std::uint64_t staticCasterVersion = 0;
+      vector<glm::mat4> staticCasterModels(sceneObjects.size(),
+					   glm::mat4(0.0F));
+      // the lighting variants of the first frame start compiling now
+      std::uint32_t startFeatures = rg::ShaderFeature::Blinn |
+				    rg::ShaderFeature::PointLight |
+				    rg::ShaderFeature::Shadows;
+      for (const SceneObject &object : sceneObjects) {
+	    object.mesh->material->shader(startFeatures);
+	    if (object.mesh->material->deferred()) {
+		  object.mesh->material->shader(rg::ShaderFeature::GBuffer);
+	    }
+      }
+      deferredLightingShaders.get(startFeatures |
+				  rg::ShaderFeature::DeferredLighting);
+
       auto &initServiceLocator = rg::ServiceLocator::Get();
       // draw in wireframe
       // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -413,12 +691,19 @@ auto main() -> int
       rg::ServiceLocator::Get().getEventController().subscribeToEvent(
 	  rg::EventType::Keyboard, &programState->camera);
 
+      // setup above went to the driver directly
+      glState.invalidate();
       while (glfwWindowShouldClose(window) == 0) {
 	    // per-frame time logic
 	    // --------------------
 	    float currentFrame = glfwGetTime();
 	    deltaTime = currentFrame - lastFrame;
 	    lastFrame = currentFrame;
+	    rg::UniformRegistry::resetFrameStats();
+	    glState.resetFrameStats();
+	    rg::ServiceLocator::Get().getTextureLoader().uploadPending(
+		TEXTURE_UPLOAD_BUDGET);
+	    shaderLibrary.update();
 
 	    // input
 	    // -----
@@ -434,157 +719,243 @@ auto main() -> int
 			 programState->clearColor.b, 1.0F);
 	    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	    glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 	    glClearColor(programState->clearColor.r, programState->clearColor.g,
 			 programState->clearColor.b, 1.0F);
 	    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	    glEnable(GL_DEPTH_TEST);
+	    glState.enable(GL_DEPTH_TEST);
 	    // don't forget to enable shader before setting uniforms
 
 	    glm::vec3 lightPos = glm::vec3(4.0 * cos(currentFrame), 4.0F,
 					   4.0 * sin(currentFrame));
-	    ourShader.use();
 	    pointLight.position = lightPos;
-	    ourShader.setVec3("pointLight.position", pointLight.position);
-	    ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-	    ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-	    ourShader.setVec3("pointLight.specular", pointLight.specular);
-	    ourShader.setFloat("pointLight.constant", pointLight.constant);
-	    ourShader.setFloat("pointLight.linear", pointLight.linear);
-	    ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-	    ourShader.setVec3("dirLight.direction", dirLight.direction);
-	    ourShader.setVec3("dirLight.ambient", dirLight.ambient);
-	    ourShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-	    ourShader.setVec3("dirLight.specular", dirLight.specular);
-
-	    ourShader.setVec3("viewPosition", programState->camera.Position);
-	    ourShader.setFloat("material.shininess", 32.0F);
-	    ourShader.setBool("Blinn", programState->Blinn);
-
-	    tableShader.use();
-	    tableShader.setVec3("dirLight.ambient", dirLight.ambient);
-	    tableShader.setVec3("dirLight.direction", dirLight.direction);
-	    tableShader.setVec3("dirLight.diffuse", dirLight.diffuse);
-	    tableShader.setVec3("dirLight.specular", dirLight.specular);
-	    tableShader.setVec3("viewPosition", programState->camera.Position);
-	    tableShader.setFloat("material.shininess", 32.0F);
-	    tableShader.setBool("Blinn", programState->Blinn);
-
-	    tableShader.setVec3("pointLight.position", pointLight.position);
-	    tableShader.setVec3("pointLight.ambient", pointLight.ambient);
-	    tableShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-	    tableShader.setVec3("pointLight.specular", pointLight.specular);
-	    tableShader.setFloat("pointLight.constant", pointLight.constant);
-	    tableShader.setFloat("pointLight.linear", pointLight.linear);
-	    tableShader.setFloat("pointLight.quadratic", pointLight.quadratic);
 
 	    // view/projection transformations
-
-	    glm::mat4 projection = glm::perspective(
-		glm::radians(80.0F), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1F,
-		100.0F);
-	    ourShader.setMat4("projection", projection);
-
+	    const float fovY = glm::radians(80.0F);
+	    const float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+	    const float nearPlane = 0.1F;
+	    const float farPlane = 100.0F;
+	    glm::mat4 projection =
+		glm::perspective(fovY, aspect, nearPlane, farPlane);
 	    glm::mat4 view = programState->camera.GetViewMatrix();
-	    ourShader.setMat4("view", view);
-	    glBindVertexArray(VAO);
-
-	    glm::mat4 model3 = glm::mat4(1.0F);
-	    model3 = glm::translate(model3, lightPos);
-	    model3 = glm::scale(model3, glm::vec3(0.3F));
-	    cubeShader.setMat4("model3", model3);
-	    cubeShader.setMat4("view", view);
-	    cubeShader.setMat4("projection", projection);
-
-	    glEnable(GL_CULL_FACE);
-	    glDrawArrays(GL_TRIANGLES, 0, 36);
-	    glDisable(GL_CULL_FACE);
-
-	    // render the loaded model
-	    glm::mat4 model = glm::mat4(0.7F);
-	    model = glm::translate(
-		model,
+	    renderQueue.begin(view, projection);
+	    gbufferQueue.begin(view, projection);
+
+	    rg::FrameDataBlock frameData{};
+	    frameData.projection = projection;
+	    frameData.view = view;
+	    frameData.viewPosition = programState->camera.Position;
+	    frameDataBuffer.update(frameData);
+	    lightsBuffer.update(MakeLightsBlock(programState));
+	    MakeSceneLights(programState, currentFrame, sceneLights);
+	    lightClusters.setProjection(fovY, aspect, nearPlane, farPlane,
+					(float)SCR_WIDTH, (float)SCR_HEIGHT);
+	    lightClusters.update(view, sceneLights);
+	    lightClusters.bind();
+
+	    std::uint32_t lightingFeatures = 0;
+	    if (programState->Blinn) {
+		  lightingFeatures |= rg::ShaderFeature::Blinn;
+	    }
+	    if (programState->pointLightInd) {
+		  lightingFeatures |= rg::ShaderFeature::PointLight;
+	    }
+
+	    planeShaders.forEach([&](Shader &planeShader) {
+		  planeShader.use();
+		  planeShader.setFloat("heightScale",
+				       programState->heightScale);
+	    });
+
+	    // object transforms
+	    lightCubeModel = glm::mat4(1.0F);
+	    lightCubeModel = glm::translate(lightCubeModel, lightPos);
+	    lightCubeModel = glm::scale(lightCubeModel, glm::vec3(0.3F));
+
+	    // the shaders drop w, so the overall scale goes into the 3x3 part
+	    plantModel = glm::scale(glm::mat4(1.0F), glm::vec3(0.7F));
+	    plantModel = glm::translate(
+		plantModel,
 		programState->plantPosition);  // translate it down so it's at
 					       // the center of the scene
-	    model = glm::scale(
-		model,
+	    plantModel = glm::scale(
+		plantModel,
 		glm::vec3(
 		    programState->plantScale));	 // it's a bit too big for our
 						 // scene, so scale it down
-	    ourShader.setMat4("model", model);
-	    ourModel.Draw(ourShader);
-
-	    glm::mat4 model2 = glm::mat4(3.0F);
-	    model2 = glm::translate(model2, programState->tablePosition);
-	    model2 = glm::scale(model2, glm::vec3(programState->tableScale));
-	    tableShader.setMat4("model2", model2);
-	    tableModel.Draw(tableShader);
-
-	    // texture objects
-
-	    // vegetation
-	    shader.use();
-	    glm::mat4 model7 = glm::mat4(1.0F);
-	    shader.setMat4("projection", projection);
-	    shader.setMat4("view", view);
-
-	    glBindVertexArray(transparentVAO);
-	    glBindTexture(GL_TEXTURE_2D, transparentTexture);
-	    for (auto i : vegetation) {
-		  model7 = glm::mat4(1.0F);
-		  model7 = glm::translate(model7, i);
-		  shader.setMat4("model7", model7);
+
+	    tableModelMatrix = glm::scale(glm::mat4(1.0F), glm::vec3(3.0F));
+	    tableModelMatrix =
+		glm::translate(tableModelMatrix, programState->tablePosition);
+	    tableModelMatrix = glm::scale(
+		tableModelMatrix, glm::vec3(programState->tableScale));
+
+	    planeModel = glm::mat4(1.0F);
+	    planeModel = glm::translate(planeModel, programState->planePosition);
+	    planeModel = glm::scale(planeModel, glm::vec3(6.1F));
+
+	    for (std::size_t i = 0; i < sceneObjects.size(); ++i) {
+		  const SceneObject &object = sceneObjects[i];
+		  objectBounds[i] =
+		      rg::transform(object.mesh->bounds, *object.model);
+		  if (object.caster == rg::ShadowCaster::Static &&
+		      *object.model != staticCasterModels[i]) {
+			staticCasterModels[i] = *object.model;
+			++staticCasterVersion;
+		  }
+	    }
+	    sceneBVH.refit(objectBounds);
+
+	    // shadow maps of the directional light; the static casters are
+	    // only drawn when their cached layer of a cascade went stale
+	    Shader *shadowShader = shaderLibrary.get(shadowProgram);
+	    if (programState->shadows && shadowShader != nullptr) {
+		  shadowCascades.setCascadeCount(
+		      programState->shadowCascadeCount);
+		  shadowCascades.update(view, fovY, aspect, nearPlane,
+					SHADOW_DISTANCE, dirLight.direction,
+					staticCasterVersion);
+		  auto drawCasters =
+		      [&](const rg::ShadowCascades::Cascade &cascade,
+			  rg::ShadowCaster caster) {
+			shadowQueue.begin(cascade.view, cascade.cullProjection);
+			for (const SceneObject &object : sceneObjects) {
+			      if (object.caster == caster) {
+				    shadowQueue.submit(rg::RenderPass::Opaque,
+						       *shadowShader,
+						       *object.mesh,
+						       *object.model);
+			      }
+			}
+			shadowShader->use();
+			shadowShader->setMat4("lightSpace",
+					      cascade.viewProjection);
+			shadowQueue.flush();
+		  };
+		  shadowCascades.render(drawCasters);
+		  shadowCascades.bind();
+		  lightingFeatures |= rg::ShaderFeature::Shadows;
+		  glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	    }
+
+	    // pick the object under the cursor, unless ImGui owns the mouse
+	    auto &inputController =
+		rg::ServiceLocator::Get().getInputController();
+	    if (inputController.getKeyState(GLFW_MOUSE_BUTTON_LEFT) ==
+		    rg::InputController::KeyState::JustPressed &&
+		!ImGui::GetIO().WantCaptureMouse) {
+		  float distance = 0.0F;
+		  programState->selectedObject = sceneBVH.raycast(
+		      MouseRay(window, projection, view), objectBounds,
+		      distance);
+	    }
+
+	    // deferred shading waits for its lighting program, the frames
+	    // before it is linked are shaded forward
+	    Shader *deferredLighting = deferredLightingShaders.get(
+		lightingFeatures | rg::ShaderFeature::DeferredLighting);
+	    bool deferred =
+		programState->deferredShading && deferredLighting != nullptr;
+
+	    // the BVH rejects whole subtrees outside the frustum, the render
+	    // queue tests the surviving objects one by one, picks the draw
+	    // order and merges repeated meshes into instanced draws
+	    visibleObjects.clear();
+	    sceneBVH.cull(rg::Frustum::fromMatrix(projection * view),
+			  visibleObjects);
+	    // levels of detail are picked from the projected size of the
+	    // object, switching levels cross-fades over a few frames
+	    float pixelsPerUnit = projection[1][1] * (float)SCR_HEIGHT * 0.5F;
+	    for (std::uint32_t index : visibleObjects) {
+		  const SceneObject &object = sceneObjects[index];
+		  rg::BoundingSphere sphere =
+		      rg::transform(object.mesh->sphere, *object.model);
+		  unsigned int lod = rg::selectLod(
+		      object.mesh->lods, sphere, programState->camera.Position,
+		      pixelsPerUnit, programState->lodPixelError);
+		  std::array<rg::LodTransition::Draw, 2> draws;
+		  unsigned int drawCount =
+		      lodTransitions[index].update(lod, currentFrame, draws);
+		  const rg::Material &material = *object.mesh->material;
+		  bool toGBuffer = deferred &&
+				   object.pass == rg::RenderPass::Opaque &&
+				   material.deferred();
+		  Shader *objectShader =
+		      toGBuffer ? material.shader(rg::ShaderFeature::GBuffer)
+				: material.shader(lightingFeatures);
+		  // not drawn until its program is linked
+		  if (objectShader == nullptr) {
+			continue;
+		  }
+		  rg::RenderQueue &queue =
+		      toGBuffer ? gbufferQueue : renderQueue;
+		  for (unsigned int i = 0; i < drawCount; ++i) {
+			queue.submit(object.pass, *objectShader, *object.mesh,
+				     *object.model, draws[i].lod,
+				     draws[i].fade);
+		  }
+	    }
+
+	    // deferred shading: the opaque surfaces go to the G-buffer, then a
+	    // screen quad lights each pixel once into the MSAA framebuffer and
+	    // hands it the depth the forward draws below test against
+	    if (deferred) {
+		  gBuffer.bindForGeometry();
+		  gbufferQueue.flush();
+		  glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		  deferredLighting->use();
+		  deferredLighting->setMat4("inverseViewProjection",
+					    glm::inverse(projection * view));
+		  gBuffer.bindTextures();
+		  glState.depthFunc(GL_ALWAYS);
+		  glState.bindVertexArray(quadVAO);
 		  glDrawArrays(GL_TRIANGLES, 0, 6);
+		  glState.depthFunc(GL_LESS);
 	    }
-	    // plane
-	    planeShader.use();
-	    planeShader.setMat4("projection", projection);
-	    planeShader.setMat4("view", view);
-
-	    model = glm::mat4(1.0F);
-	    model = glm::translate(model, programState->planePosition);
-	    model = glm::scale(model, glm::vec3(6.1F));
-	    planeShader.setMat4("model", model);
-	    planeShader.setVec3("viewPos", programState->camera.Position);
-	    planeShader.setVec3("lightPos", lightPos);
-	    planeShader.setFloat("heightScale", programState->heightScale);
-
-	    glActiveTexture(GL_TEXTURE0);
-	    glBindTexture(GL_TEXTURE_2D, diffuseMap);
-	    glActiveTexture(GL_TEXTURE1);
-	    glBindTexture(GL_TEXTURE_2D, normalMap);
-	    glActiveTexture(GL_TEXTURE2);
-	    glBindTexture(GL_TEXTURE_2D, heightMap);
-	    renderQuad();
-
-	    screenShader.use();
-	    screenShader.setBool("grayScaleInd", programState->grayScaleInd);
+	    renderQueue.flush();
+	    rg::RenderQueue::FrameStats queueStats = renderQueue.frameStats();
+	    queueStats += gbufferQueue.frameStats();
 
 	    // 2. now blit multisampled buffer(s) to normal colorbuffer of
 	    // intermediate FBO. Image is stored in screenTexture
-	    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
-	    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
+	    glState.bindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	    glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBO);
 	    glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH,
 			      SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 
 	    // 3. now render quad with scene's visuals as its texture image
-	    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
 	    glClearColor(1.0F, 1.0F, 1.0F, 1.0F);
 	    glClear(GL_COLOR_BUFFER_BIT);
-	    glDisable(GL_DEPTH_TEST);
-
-	    // draw Screen quad
-	    screenShader.use();
-	    glBindVertexArray(quadVAO);
-	    glActiveTexture(GL_TEXTURE0);
-	    glBindTexture(GL_TEXTURE_2D,
-			  screenTexture);  // use the now resolved color
-					   // attachment as the quad's texture
-	    glDrawArrays(GL_TRIANGLES, 0, 6);
+	    glState.disable(GL_DEPTH_TEST);
+
+	    // draw Screen quad; until its program is linked the resolved image
+	    // is copied to the window as it is
+	    if (Shader *screenShader = shaderLibrary.get(screenProgram)) {
+		  screenShader->use();
+		  screenShader->setBool("grayScaleInd",
+					programState->grayScaleInd);
+		  glState.bindVertexArray(quadVAO);
+		  glState.bindTexture(
+		      0, GL_TEXTURE_2D,
+		      screenTexture);  // use the now resolved color
+				       // attachment as the quad's texture
+		  glDrawArrays(GL_TRIANGLES, 0, 6);
+	    } else {
+		  glState.bindFramebuffer(GL_READ_FRAMEBUFFER, intermediateFBO);
+		  glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0,
+				    SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT,
+				    GL_NEAREST);
+	    }
 
 	    if (programState->ImGuiEnabled) {
-		  DrawImGui(programState);
+		  const SceneObject *selectedObject =
+		      programState->selectedObject >= 0
+			  ? &sceneObjects[programState->selectedObject]
+			  : nullptr;
+		  DrawImGui(programState, queueStats,
+			    lightClusters.stats(), shadowCascades.stats(),
+			    selectedObject);
 	    }
 
 	    // glfw: swap buffers and poll IO events (keys pressed/released,
@@ -595,140 +966,101 @@ auto main() -> int
 	    rg::ServiceLocator::Get().getInputController().update(deltaTime);
       }
 
-      programState->SaveToFile("resources/program_state.txt");
-      delete programState;
-      ImGui_ImplOpenGL3_Shutdown();
-      ImGui_ImplGlfw_Shutdown();
-      ImGui::DestroyContext();
-
-      glDeleteVertexArrays(1, &VAO);
-      glDeleteVertexArrays(1, &transparentVAO);
-      glDeleteBuffers(1, &VBO);
-      glDeleteBuffers(1, &transparentVBO);
       glDeleteVertexArrays(1, &quadVAO);
       glDeleteBuffers(1, &quadVBO);
       glDeleteFramebuffers(1, &framebuffer);
       glDeleteFramebuffers(1, &intermediateFBO);
       glDeleteRenderbuffers(1, &rbo);
-      // glfw: terminate, clearing all previously allocated GLFW resources.
-      // ------------------------------------------------------------------
-      glfwTerminate();
-      return 0;
+      for (unsigned int texture :
+	   {transparentTexture, diffuseMap, normalMap, heightMap}) {
+	    rg::ServiceLocator::Get().getTextureCache().release(texture);
+      }
 }
 
-// mapping
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
+// parallax mapped ground plane; the samplers of plane.fs are named after the
+// texture types so Mesh can bind them
+auto CreatePlaneMesh(unsigned int diffuseMap, unsigned int normalMap,
+		     unsigned int heightMap) -> Mesh
 {
-      if (quadVAO == 0) {
-	    // positions
-	    glm::vec3 pos1(3.0F, -0.5F, 3.0F);
-	    glm::vec3 pos2(-3.0F, -0.5F, 3.0F);
-	    glm::vec3 pos3(-3.0F, -0.5F, -3.0F);
-	    glm::vec3 pos4(3.0F, -0.5F, -3.0F);
-	    // texture coordinates
-	    glm::vec2 uv1(2.0F, 0.0F);
-	    glm::vec2 uv2(0.0F, 0.0F);
-	    glm::vec2 uv3(0.0F, 2.0F);
-	    glm::vec2 uv4(2.0F, 2.0F);
-	    // normal vector
-	    glm::vec3 nm(0.0F, 0.0F, 1.0F);
-
-	    // calculate tangent/bitangent vectors of both triangles
-	    glm::vec3 tangent1;
-	    glm::vec3 bitangent1;
-	    glm::vec3 tangent2;
-	    glm::vec3 bitangent2;
-	    // triangle 1
-	    glm::vec3 edge1 = pos2 - pos1;
-	    glm::vec3 edge2 = pos3 - pos1;
-	    glm::vec2 deltaUV1 = uv2 - uv1;
-	    glm::vec2 deltaUV2 = uv3 - uv1;
-
-	    float f =
-		1.0F / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-	    tangent1.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-	    tangent1.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-	    tangent1.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-	    tangent1 = glm::normalize(tangent1);
-
-	    bitangent1.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-	    bitangent1.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-	    bitangent1.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-	    bitangent1 = glm::normalize(bitangent1);
-
-	    // triangle 2
-	    edge1 = pos3 - pos1;
-	    edge2 = pos4 - pos1;
-	    deltaUV1 = uv3 - uv1;
-	    deltaUV2 = uv4 - uv1;
-
-	    f = 1.0F / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-	    tangent2.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-	    tangent2.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-	    tangent2.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-	    tangent2 = glm::normalize(tangent2);
-
-	    bitangent2.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-	    bitangent2.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-	    bitangent2.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-	    bitangent2 = glm::normalize(bitangent2);
-
-	    float quadVertices[] = {
-		// positions            // normal         // texcoords  //
-		// tangent                          // bitangent
-		pos1.x,	      pos1.y,	    pos1.z,	  nm.x,
-		nm.y,	      nm.z,	    uv1.x,	  uv1.y,
-		tangent1.x,   tangent1.y,   tangent1.z,	  bitangent1.x,
-		bitangent1.y, bitangent1.z, pos2.x,	  pos2.y,
-		pos2.z,	      nm.x,	    nm.y,	  nm.z,
-		uv2.x,	      uv2.y,	    tangent1.x,	  tangent1.y,
-		tangent1.z,   bitangent1.x, bitangent1.y, bitangent1.z,
-		pos3.x,	      pos3.y,	    pos3.z,	  nm.x,
-		nm.y,	      nm.z,	    uv3.x,	  uv3.y,
-		tangent1.x,   tangent1.y,   tangent1.z,	  bitangent1.x,
-		bitangent1.y, bitangent1.z,
-
-		pos1.x,	      pos1.y,	    pos1.z,	  nm.x,
-		nm.y,	      nm.z,	    uv1.x,	  uv1.y,
-		tangent2.x,   tangent2.y,   tangent2.z,	  bitangent2.x,
-		bitangent2.y, bitangent2.z, pos3.x,	  pos3.y,
-		pos3.z,	      nm.x,	    nm.y,	  nm.z,
-		uv3.x,	      uv3.y,	    tangent2.x,	  tangent2.y,
-		tangent2.z,   bitangent2.x, bitangent2.y, bitangent2.z,
-		pos4.x,	      pos4.y,	    pos4.z,	  nm.x,
-		nm.y,	      nm.z,	    uv4.x,	  uv4.y,
-		tangent2.x,   tangent2.y,   tangent2.z,	  bitangent2.x,
-		bitangent2.y, bitangent2.z};
-	    // plane VAO
-	    glGenVertexArrays(1, &quadVAO);
-	    glGenBuffers(1, &quadVBO);
-	    glBindVertexArray(quadVAO);
-	    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-	    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
-			 GL_STATIC_DRAW);
-	    glEnableVertexAttribArray(0);
-	    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float),
-				  (void *)nullptr);
-	    glEnableVertexAttribArray(1);
-	    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float),
-				  (void *)(3 * sizeof(float)));
-	    glEnableVertexAttribArray(2);
-	    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(float),
-				  (void *)(6 * sizeof(float)));
-	    glEnableVertexAttribArray(3);
-	    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float),
-				  (void *)(8 * sizeof(float)));
-	    glEnableVertexAttribArray(4);
-	    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float),
-				  (void *)(11 * sizeof(float)));
-      }
-      glBindVertexArray(quadVAO);
-      glDrawArrays(GL_TRIANGLES, 0, 6);
-      glBindVertexArray(0);
+      // positions
+      glm::vec3 pos1(3.0F, -0.5F, 3.0F);
+      glm::vec3 pos2(-3.0F, -0.5F, 3.0F);
+      glm::vec3 pos3(-3.0F, -0.5F, -3.0F);
+      glm::vec3 pos4(3.0F, -0.5F, -3.0F);
+      // texture coordinates
+      glm::vec2 uv1(2.0F, 0.0F);
+      glm::vec2 uv2(0.0F, 0.0F);
+      glm::vec2 uv3(0.0F, 2.0F);
+      glm::vec2 uv4(2.0F, 2.0F);
+      // normal vector
+      glm::vec3 nm(0.0F, 0.0F, 1.0F);
+
+      // calculate tangent/bitangent vectors of both triangles
+      glm::vec3 tangent1;
+      glm::vec3 bitangent1;
+      glm::vec3 tangent2;
+      glm::vec3 bitangent2;
+      // triangle 1
+      glm::vec3 edge1 = pos2 - pos1;
+      glm::vec3 edge2 = pos3 - pos1;
+      glm::vec2 deltaUV1 = uv2 - uv1;
+      glm::vec2 deltaUV2 = uv3 - uv1;
+
+      float f = 1.0F / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+      tangent1.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+      tangent1.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+      tangent1.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+      tangent1 = glm::normalize(tangent1);
+
+      bitangent1.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+      bitangent1.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+      bitangent1.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+      bitangent1 = glm::normalize(bitangent1);
+
+      // triangle 2
+      edge1 = pos3 - pos1;
+      edge2 = pos4 - pos1;
+      deltaUV1 = uv3 - uv1;
+      deltaUV2 = uv4 - uv1;
+
+      f = 1.0F / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+
+      tangent2.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+      tangent2.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+      tangent2.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+      tangent2 = glm::normalize(tangent2);
+
+      bitangent2.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+      bitangent2.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+      bitangent2.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+      bitangent2 = glm::normalize(bitangent2);
+
+      auto makeVertex = [&nm](glm::vec3 position, glm::vec2 uv,
+			      glm::vec3 tangent, glm::vec3 bitangent) {
+	    return Vertex{position, nm, uv, tangent, bitangent};
+      };
+      vector<Vertex> vertices{
+	  makeVertex(pos1, uv1, tangent1, bitangent1),
+	  makeVertex(pos2, uv2, tangent1, bitangent1),
+	  makeVertex(pos3, uv3, tangent1, bitangent1),
+	  makeVertex(pos1, uv1, tangent2, bitangent2),
+	  makeVertex(pos3, uv3, tangent2, bitangent2),
+	  makeVertex(pos4, uv4, tangent2, bitangent2),
+      };
+      vector<Texture> textures{
+	  Texture{diffuseMap, rg::TextureType::Diffuse, "ground.jpg"},
+	  Texture{normalMap, rg::TextureType::Normal, "ground_normal.jpg"},
+	  Texture{heightMap, rg::TextureType::Height, "ground_disp.png"},
+      };
+      return {vertices, SequentialIndices(vertices.size()), textures};
+}
+
+auto SequentialIndices(std::size_t count) -> vector<unsigned int>
+{
+      vector<unsigned int> indices(count);
+      std::iota(indices.begin(), indices.end(), 0U);
+      return indices;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this
@@ -762,7 +1094,7 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
       // width and height will be significantly larger than specified on retina
       // displays.
       // glViewport(0, 0, width, height);
-      glViewport(0, 0, 800, 600);
+      rg::ServiceLocator::Get().getGLState().viewport(0, 0, 800, 600);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -786,7 +1118,40 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
 #endif
 }
 
-void DrawImGui(ProgramState *programState)
+// glfw: mouse buttons are tracked by the input controller like keys
+// -----------------------------------------------------------------
+void mouse_button_callback(GLFWwindow *window, int button, int action,
+			   int mods)
+{
+      rg::ServiceLocator::Get().getInputController().processMouseButtonCallback(
+	  button, action);
+}
+
+auto MouseRay(GLFWwindow *window, const glm::mat4 &projection,
+	      const glm::mat4 &view) -> rg::Ray
+{
+      const auto &mouse =
+	  rg::ServiceLocator::Get().getInputController().getMouseMovementData();
+      int width = 0;
+      int height = 0;
+      glfwGetWindowSize(window, &width, &height);
+      float x = 2.0F * (float)mouse.currentX / (float)width - 1.0F;
+      float y = 1.0F - 2.0F * (float)mouse.currentY / (float)height;
+
+      glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+      glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x, y, -1.0F, 1.0F);
+      glm::vec4 farPoint = inverseViewProjection * glm::vec4(x, y, 1.0F, 1.0F);
+      nearPoint /= nearPoint.w;
+      farPoint /= farPoint.w;
+      return rg::Ray{glm::vec3(nearPoint),
+		     glm::normalize(glm::vec3(farPoint - nearPoint))};
+}
+
+void DrawImGui(ProgramState *programState,
+	       const rg::RenderQueue::FrameStats &renderQueueStats,
+	       const rg::LightClusters::Stats &lightClusterStats,
+	       const rg::ShadowCascades::Stats &shadowStats,
+	       const SceneObject *selectedObject)
 {
       ImGui_ImplOpenGL3_NewFrame();
       ImGui_ImplGlfw_NewFrame();
@@ -838,8 +1203,97 @@ void DrawImGui(ProgramState *programState)
 	    ImGui::End();
       }
 
+      if (selectedObject != nullptr) {
+	    ImGui::Begin("Selected object");
+	    ImGui::Text("%s", selectedObject->name.c_str());
+	    if (selectedObject->position != nullptr) {
+		  ImGui::DragFloat3("Position",
+				    (float *)selectedObject->position, 0.05F);
+	    }
+	    ImGui::End();
+      }
+
+      {
+	    ImGui::Begin("Render stats");
+	    const auto &uniformStats = rg::UniformRegistry::stats();
+	    ImGui::Text("Uniform lookups: %u", uniformStats.lookups);
+	    ImGui::Text("Uniform uploads: %u", uniformStats.uploads);
+	    ImGui::Text("Uniform uploads skipped: %u", uniformStats.skipped);
+	    const auto &stateStats = rg::ServiceLocator::Get().getGLState().frameStats();
+	    ImGui::Text("GL state changes issued: %u", stateStats.issued);
+	    ImGui::Text("GL state changes filtered: %u", stateStats.filtered);
+	    ImGui::Text("Draw packets: %u", renderQueueStats.packets);
+	    ImGui::Text("Visible: %u, culled: %u", renderQueueStats.visible,
+			renderQueueStats.culled);
+	    ImGui::Text("GL %d.%d, multi draw indirect %s", GLVersion.major,
+			GLVersion.minor,
+			rg::glExtensions().multiDrawIndirect ? "on" : "off");
+	    ImGui::Text("Draw calls: %u, multi draws: %u", renderQueueStats.batches,
+			renderQueueStats.multiDraws);
+	    ImGui::Text("Multi draws split by quantization: %u",
+			renderQueueStats.quantizationSplits);
+	    const auto geometryStats =
+		rg::ServiceLocator::Get().getGeometryPool().stats();
+	    ImGui::Text("Geometry arenas: %u, %zu KB vertices, %zu KB indices",
+			geometryStats.arenas, geometryStats.vertexBytes / 1024,
+			geometryStats.indexBytes / 1024);
+	    ImGui::Text("Triangles: %u", renderQueueStats.triangles);
+	    const rg::MeshOptimizerStats optimizerStats =
+		rg::meshOptimizerStats();
+	    ImGui::Text("Optimized meshes: %u, vertices %zu -> %zu, "
+			"ACMR %.2f -> %.2f",
+			optimizerStats.meshes, optimizerStats.importedVertices,
+			optimizerStats.optimizedVertices,
+			optimizerStats.importedACMR,
+			optimizerStats.optimizedACMR);
+	    const auto textureStats =
+		rg::ServiceLocator::Get().getTextureLoader().stats();
+	    ImGui::Text("Textures pending: %u (%u streaming), uploaded: %u "
+			"(%u compressed, %zu KB)",
+			textureStats.pending, textureStats.streaming,
+			textureStats.uploaded, textureStats.compressed,
+			textureStats.uploadedBytes / 1024);
+	    const auto textureCacheStats =
+		rg::ServiceLocator::Get().getTextureCache().stats();
+	    ImGui::Text("Texture cache: %u textures, %u references, %zu KB",
+			textureCacheStats.textures,
+			textureCacheStats.references,
+			textureCacheStats.residentBytes / 1024);
+	    ImGui::Text("Texture cache hits: %u (%u by content), misses: %u",
+			textureCacheStats.hits, textureCacheStats.contentHits,
+			textureCacheStats.misses);
+	    ImGui::DragFloat("LOD pixel error", &programState->lodPixelError,
+			     0.1F, 0.0F, 16.0F);
+	    ImGui::Text("Point lights: %u, in clusters: %u (at most %u, %u "
+			"dropped), assigned in %.2f ms",
+			lightClusterStats.lights, lightClusterStats.references,
+			lightClusterStats.maxPerCluster,
+			lightClusterStats.dropped,
+			lightClusterStats.assignMilliseconds);
+	    ImGui::SliderInt("Small lights", &programState->smallLightCount, 0,
+			     1024);
+	    ImGui::Checkbox("Deferred shading", &programState->deferredShading);
+	    unsigned int shadowLayers =
+		shadowStats.cacheHits + shadowStats.cacheMisses;
+	    ImGui::Text("Shadow passes: %.2f ms (GPU), cache hits: %u, "
+			"misses: %u (%.0f%% hit rate)",
+			shadowStats.gpuMilliseconds, shadowStats.cacheHits,
+			shadowStats.cacheMisses,
+			shadowLayers == 0 ? 0.0
+					  : 100.0 * shadowStats.cacheHits /
+						shadowLayers);
+	    ImGui::Checkbox("Shadows", &programState->shadows);
+	    ImGui::SliderInt("Shadow cascades",
+			     &programState->shadowCascadeCount,
+			     rg::ShadowCascades::MIN_CASCADES,
+			     rg::MAX_SHADOW_CASCADES);
+	    ImGui::End();
+      }
+
       ImGui::Render();
       ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+      // the backend restores what it changes, but behind the shadow's back
+      rg::ServiceLocator::Get().getGLState().invalidate();
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action,
@@ -862,24 +1316,20 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action,
       }
 
       if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
-	    PointLight &pointLight = programState->pointLight;
-	    if (programState->pointLightInd) {
-		  // disable point light
-		  pointLight.ambient = glm::vec3(0.0, 0.0, 0.0);
-		  pointLight.diffuse = glm::vec3(0.0, 0.0, 0.0);
-		  pointLight.specular = glm::vec3(0.0, 0.0, 0.0);
-		  programState->pointLightInd = false;
-	    } else {
-		  pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
-		  pointLight.diffuse = glm::vec3(0.8, 0.8, 0.8);
-		  pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-		  programState->pointLightInd = true;
-	    }
+	    // the lighting shaders switch to a variant without the point light
+	    programState->pointLightInd = !programState->pointLightInd;
       }
       if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
 	    // enable or disable gray scale
 	    programState->grayScaleInd = !programState->grayScaleInd;
       }
+      if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) {
+	    // switch between forward and deferred shading
+	    programState->deferredShading = !programState->deferredShading;
+      }
+      if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) {
+	    programState->shadows = !programState->shadows;
+      }
 
       if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
 	    programState->camera.ProcessKeyboard(Direction::FORWARD, deltaTime);
@@ -899,50 +1349,12 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action,
       }
 }
 
-auto loadTexture(char const *path) -> unsigned int
+// shared through the texture cache, decoded on the thread pool and uploaded
+// by the render loop; RGBA images clamp to the edge to prevent
+// semi-transparent borders. Due to interpolation they would take texels from
+// the next repeat
+auto loadTexture(char const *path, rg::TextureUsage usage) -> unsigned int
 {
-      unsigned int textureID;
-      glGenTextures(1, &textureID);
-
-      int width;
-      int height;
-      int nrComponents;
-      unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-      if (data != nullptr) {
-	    GLenum format = GL_RGBA;
-	    if (nrComponents == 1) {
-		  format = GL_RED;
-	    } else if (nrComponents == 3) {
-		  format = GL_RGB;
-	    } else if (nrComponents == 4) {
-		  format = GL_RGBA;
-	    }
-
-	    glBindTexture(GL_TEXTURE_2D, textureID);
-	    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-			 GL_UNSIGNED_BYTE, data);
-	    glGenerateMipmap(GL_TEXTURE_2D);
-
-	    glTexParameteri(
-		GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
-		format == GL_RGBA
-		    ? GL_CLAMP_TO_EDGE
-		    : GL_REPEAT);  // for this tutorial: use GL_CLAMP_TO_EDGE to
-				   // prevent semi-transparent borders. Due to
-				   // interpolation it takes texels from next
-				   // repeat
-	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
-			    format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-			    GL_LINEAR_MIPMAP_LINEAR);
-	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	    stbi_image_free(data);
-      } else {
-	    std::cout << "Texture failed to load at path: " << path
-		      << std::endl;
-	    stbi_image_free(data);
-      }
-
-      return textureID;
+      return rg::ServiceLocator::Get().getTextureCache().acquire(path, usage,
+								 true);
 }
@@ -0,0 +1,80 @@
+#include <rg/material.h>
+
+#include <learnopengl/mesh.h>
+#include <rg/service_locator.h>
+
+#include <array>
+
+namespace rg
+{
+
+Material::Material(ShaderVariants& variants,
+		   const std::vector<Texture>& textures,
+		   const MaterialBlock& parameters)
+    : m_variants(&variants)
+{
+      setTextures(textures);
+      setParameters(parameters);
+}
+
+Material::Material(ShaderLibrary& library, ShaderLibrary::Handle program,
+		   const std::vector<Texture>& textures,
+		   const MaterialBlock& parameters)
+    : m_library(&library), m_program(program)
+{
+      setTextures(textures);
+      setParameters(parameters);
+}
+
+auto Material::shader(std::uint32_t frameFeatures) const -> Shader*
+{
+      if (m_variants != nullptr) {
+	    return m_variants->get(frameFeatures | m_features);
+      }
+      return m_library->get(m_program);
+}
+
+auto Material::deferred() const -> bool
+{
+      return m_variants != nullptr &&
+	     m_variants->supports(ShaderFeature::GBuffer);
+}
+
+void Material::bind() const
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      for (const Binding& binding : m_bindings) {
+	    state.bindTexture(binding.unit, GL_TEXTURE_2D, binding.texture);
+      }
+      m_parameters.bind();
+}
+
+void Material::setParameters(const MaterialBlock& parameters)
+{
+      m_parameters.update(parameters);
+}
+
+// Textures of a type take its units in order; ones past the samplers a
+// shader may declare are left out.
+void Material::setTextures(const std::vector<Texture>& textures)
+{
+      std::array<unsigned int, TEXTURE_TYPE_COUNT> counts{};
+      for (const Texture& texture : textures) {
+	    unsigned int& count =
+		counts[static_cast<unsigned int>(texture.type)];
+	    if (count == MAX_TEXTURES_PER_TYPE) {
+		  continue;
+	    }
+	    m_bindings.push_back(
+		Binding{textureUnit(texture.type, count), texture.id});
+	    ++count;
+      }
+      if (counts[static_cast<unsigned int>(TextureType::Diffuse)] > 1) {
+	    m_features |= ShaderFeature::Diffuse2;
+      }
+      if (counts[static_cast<unsigned int>(TextureType::Normal)] > 0) {
+	    m_features |= ShaderFeature::NormalMap;
+      }
+}
+
+}  // namespace rg
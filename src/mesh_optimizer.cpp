@@ -0,0 +1,402 @@
+#include <rg/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+namespace rg
+{
+namespace
+{
+// tuning from Forsyth, "Linear-Speed Vertex Cache Optimisation"
+constexpr int VERTEX_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5F;
+constexpr float LAST_TRIANGLE_SCORE = 0.75F;
+constexpr float VALENCE_BOOST_SCALE = 2.0F;
+constexpr float VALENCE_BOOST_POWER = 0.5F;
+
+// size of the FIFO cache simulated when looking for cluster boundaries
+constexpr unsigned int OVERDRAW_CACHE_SIZE = 16;
+
+// the totals behind meshOptimizerStats, with the cache misses summed so the
+// ratios can be averaged over all triangles
+struct OptimizationTotals {
+      std::mutex mutex;
+      MeshOptimizerStats stats;
+      double importedMisses = 0.0;
+      double optimizedMisses = 0.0;
+      std::size_t triangles = 0;
+};
+
+auto optimizationTotals() -> OptimizationTotals&
+{
+      static OptimizationTotals totals;
+      return totals;
+}
+
+auto vertexScore(int cachePosition, unsigned int remainingTriangles) -> float
+{
+      if (remainingTriangles == 0) {
+	    return -1.0F;
+      }
+      float score = 0.0F;
+      if (cachePosition >= 0) {
+	    // the vertices of the last triangle get a fixed score so that the
+	    // next one does not simply reuse the same edge
+	    if (cachePosition < 3) {
+		  score = LAST_TRIANGLE_SCORE;
+	    } else {
+		  float scaler = 1.0F / (VERTEX_CACHE_SIZE - 3);
+		  score = std::pow(1.0F - (cachePosition - 3) * scaler,
+				   CACHE_DECAY_POWER);
+	    }
+      }
+      // boost vertices with few triangles left so that they are finished
+      // off instead of leaving lone triangles behind
+      return score + VALENCE_BOOST_SCALE *
+			 std::pow(static_cast<float>(remainingTriangles),
+				  -VALENCE_BOOST_POWER);
+}
+
+// FIFO post-transform cache simulation, a vertex is cached while fewer
+// than cacheSize misses happened since it was loaded
+struct FifoCache {
+      std::vector<unsigned int> timestamps;
+      unsigned int cacheSize;
+      unsigned int time;
+
+      FifoCache(std::size_t vertexCount, unsigned int size)
+	  : timestamps(vertexCount, 0), cacheSize(size), time(size + 1)
+      {
+      }
+
+      auto misses(const unsigned int* triangle) -> unsigned int
+      {
+	    unsigned int result = 0;
+	    for (int corner = 0; corner < 3; ++corner) {
+		  unsigned int index = triangle[corner];
+		  if (time - timestamps[index] > cacheSize) {
+			timestamps[index] = time++;
+			++result;
+		  }
+	    }
+	    return result;
+      }
+
+      void flush() { time += cacheSize + 1; }
+};
+}  // namespace
+
+auto generateVertexRemap(std::span<unsigned int> remap, const void* vertices,
+			 std::size_t vertexCount, std::size_t vertexSize)
+    -> std::size_t
+{
+      const char* bytes = static_cast<const char*>(vertices);
+      std::unordered_map<std::string_view, unsigned int> unique;
+      unique.reserve(vertexCount);
+      std::size_t uniqueCount = 0;
+      for (std::size_t i = 0; i < vertexCount; ++i) {
+	    std::string_view key(bytes + i * vertexSize, vertexSize);
+	    auto [it, inserted] = unique.try_emplace(key, uniqueCount);
+	    if (inserted) {
+		  ++uniqueCount;
+	    }
+	    remap[i] = it->second;
+      }
+      return uniqueCount;
+}
+
+auto generateFetchRemap(std::span<unsigned int> remap,
+			std::span<const unsigned int> indices) -> std::size_t
+{
+      std::fill(remap.begin(), remap.end(), UNUSED_VERTEX);
+      std::size_t count = 0;
+      for (unsigned int index : indices) {
+	    if (remap[index] == UNUSED_VERTEX) {
+		  remap[index] = count++;
+	    }
+      }
+      return count;
+}
+
+void remapIndices(std::span<unsigned int> indices,
+		  std::span<const unsigned int> remap)
+{
+      for (unsigned int& index : indices) {
+	    index = remap[index];
+      }
+}
+
+void optimizeVertexCache(std::span<unsigned int> indices,
+			 std::size_t vertexCount)
+{
+      std::size_t triangleCount = indices.size() / 3;
+      if (triangleCount == 0) {
+	    return;
+      }
+
+      // triangles around every vertex, the first remaining[v] entries of
+      // each list are the ones not emitted yet
+      std::vector<unsigned int> offsets(vertexCount + 1, 0);
+      for (std::size_t i = 0; i < triangleCount * 3; ++i) {
+	    ++offsets[indices[i] + 1];
+      }
+      std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+      std::vector<unsigned int> remaining(vertexCount);
+      for (std::size_t v = 0; v < vertexCount; ++v) {
+	    remaining[v] = offsets[v + 1] - offsets[v];
+      }
+      std::vector<unsigned int> adjacency(triangleCount * 3);
+      std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+      for (std::size_t i = 0; i < triangleCount * 3; ++i) {
+	    adjacency[fill[indices[i]]++] = i / 3;
+      }
+
+      std::vector<int> cachePositions(vertexCount, -1);
+      std::vector<float> vertexScores(vertexCount);
+      for (std::size_t v = 0; v < vertexCount; ++v) {
+	    vertexScores[v] = vertexScore(-1, remaining[v]);
+      }
+      std::vector<float> triangleScores(triangleCount);
+      int best = 0;
+      for (std::size_t t = 0; t < triangleCount; ++t) {
+	    triangleScores[t] = vertexScores[indices[t * 3]] +
+				vertexScores[indices[t * 3 + 1]] +
+				vertexScores[indices[t * 3 + 2]];
+	    if (triangleScores[t] > triangleScores[best]) {
+		  best = static_cast<int>(t);
+	    }
+      }
+
+      std::vector<bool> emitted(triangleCount, false);
+      std::vector<unsigned int> result;
+      result.reserve(triangleCount * 3);
+      std::vector<unsigned int> cache;
+      std::vector<unsigned int> nextCache;
+      std::size_t nextUnemitted = 0;
+
+      while (best >= 0) {
+	    emitted[best] = true;
+	    const unsigned int* triangle = &indices[best * 3];
+	    result.insert(result.end(), triangle, triangle + 3);
+
+	    for (int corner = 0; corner < 3; ++corner) {
+		  unsigned int v = triangle[corner];
+		  unsigned int* list = &adjacency[offsets[v]];
+		  unsigned int* last = list + remaining[v];
+		  std::iter_swap(std::find(list, last, best), last - 1);
+		  --remaining[v];
+	    }
+
+	    // the triangle goes to the front, the rest keeps its order
+	    nextCache.clear();
+	    for (int corner = 0; corner < 3; ++corner) {
+		  if (std::find(nextCache.begin(), nextCache.end(),
+				triangle[corner]) == nextCache.end()) {
+			nextCache.push_back(triangle[corner]);
+		  }
+	    }
+	    for (unsigned int v : cache) {
+		  if (std::find(nextCache.begin(), nextCache.end(), v) ==
+		      nextCache.end()) {
+			nextCache.push_back(v);
+		  }
+	    }
+
+	    // rescore the cached vertices, including the ones just pushed
+	    // out, and propagate the change to their triangles
+	    for (std::size_t i = 0; i < nextCache.size(); ++i) {
+		  unsigned int v = nextCache[i];
+		  int position = i < VERTEX_CACHE_SIZE ? static_cast<int>(i) : -1;
+		  cachePositions[v] = position;
+		  float score = vertexScore(position, remaining[v]);
+		  float delta = score - vertexScores[v];
+		  vertexScores[v] = score;
+		  for (unsigned int a = 0; a < remaining[v]; ++a) {
+			triangleScores[adjacency[offsets[v] + a]] += delta;
+		  }
+	    }
+	    if (nextCache.size() > VERTEX_CACHE_SIZE) {
+		  nextCache.resize(VERTEX_CACHE_SIZE);
+	    }
+	    std::swap(cache, nextCache);
+
+	    // only triangles touching the cache are candidates, otherwise
+	    // continue with the next one in input order
+	    best = -1;
+	    float bestScore = -1.0F;
+	    for (unsigned int v : cache) {
+		  for (unsigned int a = 0; a < remaining[v]; ++a) {
+			unsigned int t = adjacency[offsets[v] + a];
+			if (triangleScores[t] > bestScore) {
+			      bestScore = triangleScores[t];
+			      best = static_cast<int>(t);
+			}
+		  }
+	    }
+	    if (best < 0) {
+		  while (nextUnemitted < triangleCount &&
+			 emitted[nextUnemitted]) {
+			++nextUnemitted;
+		  }
+		  if (nextUnemitted < triangleCount) {
+			best = static_cast<int>(nextUnemitted);
+		  }
+	    }
+      }
+
+      std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void optimizeOverdraw(std::span<unsigned int> indices,
+		      std::span<const glm::vec3> positions, float threshold)
+{
+      std::size_t triangleCount = indices.size() / 3;
+      if (triangleCount < 2) {
+	    return;
+      }
+
+      // hard boundaries where the cache starts over, every vertex of the
+      // triangle misses
+      FifoCache cache(positions.size(), OVERDRAW_CACHE_SIZE);
+      std::vector<std::size_t> hardBoundaries;
+      for (std::size_t t = 0; t < triangleCount; ++t) {
+	    if (cache.misses(&indices[t * 3]) == 3 || t == 0) {
+		  hardBoundaries.push_back(t);
+	    }
+      }
+      hardBoundaries.push_back(triangleCount);
+
+      // soft boundaries once a cluster reached the ACMR of its hard cluster
+      std::vector<std::size_t> boundaries;
+      for (std::size_t h = 0; h + 1 < hardBoundaries.size(); ++h) {
+	    std::size_t first = hardBoundaries[h];
+	    std::size_t last = hardBoundaries[h + 1];
+	    cache.flush();
+	    unsigned int totalMisses = 0;
+	    for (std::size_t t = first; t < last; ++t) {
+		  totalMisses += cache.misses(&indices[t * 3]);
+	    }
+	    float clusterMisses =
+		static_cast<float>(totalMisses) / (last - first) * threshold;
+
+	    cache.flush();
+	    boundaries.push_back(first);
+	    std::size_t start = first;
+	    unsigned int misses = 0;
+	    for (std::size_t t = first; t + 1 < last; ++t) {
+		  misses += cache.misses(&indices[t * 3]);
+		  if (misses <= clusterMisses * (t + 1 - start)) {
+			boundaries.push_back(t + 1);
+			start = t + 1;
+			misses = 0;
+			cache.flush();
+		  }
+	    }
+      }
+      boundaries.push_back(triangleCount);
+
+      struct Cluster {
+	    std::size_t first;
+	    std::size_t last;
+	    float sortKey;
+      };
+      std::vector<Cluster> clusters;
+      std::vector<glm::vec3> centroids;
+      std::vector<glm::vec3> normals;
+      glm::vec3 meshCentroid(0.0F);
+      float meshArea = 0.0F;
+      for (std::size_t c = 0; c + 1 < boundaries.size(); ++c) {
+	    glm::vec3 centroid(0.0F);
+	    glm::vec3 normal(0.0F);
+	    float area = 0.0F;
+	    for (std::size_t t = boundaries[c]; t < boundaries[c + 1]; ++t) {
+		  const glm::vec3& a = positions[indices[t * 3]];
+		  const glm::vec3& b = positions[indices[t * 3 + 1]];
+		  const glm::vec3& d = positions[indices[t * 3 + 2]];
+		  glm::vec3 cross = glm::cross(b - a, d - a);
+		  float triangleArea = glm::length(cross);
+		  centroid += (a + b + d) * (triangleArea / 3.0F);
+		  normal += cross;
+		  area += triangleArea;
+	    }
+	    meshCentroid += centroid;
+	    meshArea += area;
+	    centroids.push_back(area > 0.0F ? centroid / area : centroid);
+	    normals.push_back(normal);
+	    clusters.push_back(Cluster{boundaries[c], boundaries[c + 1], 0.0F});
+      }
+      if (meshArea > 0.0F) {
+	    meshCentroid /= meshArea;
+      }
+
+      // clusters facing away from the center are in front from most
+      // directions the mesh is seen from
+      for (std::size_t c = 0; c < clusters.size(); ++c) {
+	    float length = glm::length(normals[c]);
+	    if (length > 0.0F) {
+		  clusters[c].sortKey =
+		      glm::dot(centroids[c] - meshCentroid, normals[c] / length);
+	    }
+      }
+      std::stable_sort(clusters.begin(), clusters.end(),
+		       [](const Cluster& l, const Cluster& r) {
+			     return l.sortKey > r.sortKey;
+		       });
+
+      std::vector<unsigned int> result;
+      result.reserve(triangleCount * 3);
+      for (const Cluster& cluster : clusters) {
+	    result.insert(result.end(), indices.begin() + cluster.first * 3,
+			  indices.begin() + cluster.last * 3);
+      }
+      std::copy(result.begin(), result.end(), indices.begin());
+}
+
+auto computeACMR(std::span<const unsigned int> indices,
+		 std::size_t vertexCount, unsigned int cacheSize) -> float
+{
+      std::size_t triangleCount = indices.size() / 3;
+      if (triangleCount == 0) {
+	    return 0.0F;
+      }
+      FifoCache cache(vertexCount, cacheSize);
+      unsigned int misses = 0;
+      for (std::size_t t = 0; t < triangleCount; ++t) {
+	    misses += cache.misses(&indices[t * 3]);
+      }
+      return static_cast<float>(misses) / triangleCount;
+}
+
+void recordMeshOptimization(std::size_t importedVertices,
+			    std::size_t optimizedVertices, float importedACMR,
+			    float optimizedACMR, std::size_t triangleCount)
+{
+      OptimizationTotals& totals = optimizationTotals();
+      std::lock_guard<std::mutex> lock(totals.mutex);
+      ++totals.stats.meshes;
+      totals.stats.importedVertices += importedVertices;
+      totals.stats.optimizedVertices += optimizedVertices;
+      totals.importedMisses += double(importedACMR) * triangleCount;
+      totals.optimizedMisses += double(optimizedACMR) * triangleCount;
+      totals.triangles += triangleCount;
+}
+
+auto meshOptimizerStats() -> MeshOptimizerStats
+{
+      OptimizationTotals& totals = optimizationTotals();
+      std::lock_guard<std::mutex> lock(totals.mutex);
+      MeshOptimizerStats stats = totals.stats;
+      if (totals.triangles != 0) {
+	    stats.importedACMR =
+		static_cast<float>(totals.importedMisses / totals.triangles);
+	    stats.optimizedACMR =
+		static_cast<float>(totals.optimizedMisses / totals.triangles);
+      }
+      return stats;
+}
+
+}  // namespace rg
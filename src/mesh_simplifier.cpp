@@ -0,0 +1,256 @@
+#include <rg/bounds.h>
+#include <rg/mesh_simplifier.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+
+namespace rg
+{
+namespace
+{
+// Symmetric 4x4 matrix summing the squared distances to a set of planes.
+struct Quadric {
+      std::array<double, 10> m{};
+
+      // plane ax + by + cz + d = 0 with a unit normal
+      static auto fromPlane(double a, double b, double c, double d) -> Quadric
+      {
+	    Quadric q;
+	    q.m = {a * a, a * b, a * c, a * d, b * b,
+		   b * c, b * d, c * c, c * d, d * d};
+	    return q;
+      }
+
+      void add(const Quadric& other)
+      {
+	    for (std::size_t i = 0; i < m.size(); ++i) {
+		  m[i] += other.m[i];
+	    }
+      }
+
+      auto evaluate(const glm::vec3& v) const -> double
+      {
+	    double x = v.x;
+	    double y = v.y;
+	    double z = v.z;
+	    return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z +
+		   2 * m[3] * x + m[4] * y * y + 2 * m[5] * y * z +
+		   2 * m[6] * y + m[7] * z * z + 2 * m[8] * z + m[9];
+      }
+};
+
+struct Collapse {
+      unsigned int from;
+      unsigned int to;
+      double cost;
+};
+
+auto triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    -> glm::vec3
+{
+      return glm::cross(b - a, c - a);
+}
+}  // namespace
+
+auto simplifyMesh(std::span<const glm::vec3> positions,
+		  std::span<const unsigned int> indices,
+		  std::size_t targetIndexCount, float targetError,
+		  float& resultError) -> std::vector<unsigned int>
+{
+      std::vector<unsigned int> result(indices.begin(), indices.end());
+      resultError = 0.0F;
+      std::size_t vertexCount = positions.size();
+
+      AABB bounds;
+      for (const glm::vec3& position : positions) {
+	    bounds.extend(position);
+      }
+      float radius = bounds.empty() ? 0.0F : glm::length(bounds.extent());
+      if (radius <= 0.0F || result.size() <= targetIndexCount) {
+	    return result;
+      }
+      double maxCost = (double)targetError * radius * targetError * radius;
+
+      // quadrics of the planes around every vertex
+      std::vector<Quadric> quadrics(vertexCount);
+      for (std::size_t i = 0; i + 2 < result.size(); i += 3) {
+	    const glm::vec3& a = positions[result[i]];
+	    glm::vec3 normal = triangleNormal(a, positions[result[i + 1]],
+					      positions[result[i + 2]]);
+	    float length = glm::length(normal);
+	    if (length == 0.0F) {
+		  continue;
+	    }
+	    normal /= length;
+	    Quadric q = Quadric::fromPlane(normal.x, normal.y, normal.z,
+					   -glm::dot(normal, a));
+	    for (int corner = 0; corner < 3; ++corner) {
+		  quadrics[result[i + corner]].add(q);
+	    }
+      }
+
+      // an edge seen in only one direction is on an open border
+      std::vector<std::uint64_t> edges;
+      edges.reserve(result.size());
+      for (std::size_t i = 0; i + 2 < result.size(); i += 3) {
+	    for (int corner = 0; corner < 3; ++corner) {
+		  std::uint64_t a = result[i + corner];
+		  std::uint64_t b = result[i + (corner + 1) % 3];
+		  edges.push_back(a << 32 | b);
+	    }
+      }
+      std::sort(edges.begin(), edges.end());
+      std::vector<bool> locked(vertexCount, false);
+      for (std::uint64_t edge : edges) {
+	    std::uint64_t reverse = edge << 32 | edge >> 32;
+	    if (!std::binary_search(edges.begin(), edges.end(), reverse)) {
+		  locked[edge >> 32] = true;
+		  locked[edge & 0xFFFFFFFF] = true;
+	    }
+      }
+
+      std::vector<unsigned int> remap(vertexCount);
+      std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+      std::vector<unsigned int> vertexTriangles;
+      std::vector<Collapse> collapses;
+      std::vector<bool> touched(vertexCount);
+      double passError = 0.0;
+
+      while (result.size() > targetIndexCount) {
+	    std::size_t triangleCount = result.size() / 3;
+
+	    // triangles around every vertex
+	    std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+	    for (unsigned int index : result) {
+		  ++triangleOffsets[index + 1];
+	    }
+	    std::partial_sum(triangleOffsets.begin(), triangleOffsets.end(),
+			     triangleOffsets.begin());
+	    vertexTriangles.resize(result.size());
+	    std::vector<unsigned int> fill(triangleOffsets.begin(),
+					   triangleOffsets.end() - 1);
+	    for (std::size_t i = 0; i < result.size(); ++i) {
+		  vertexTriangles[fill[result[i]]++] = i / 3;
+	    }
+
+	    // cheapest direction of every edge that may collapse
+	    collapses.clear();
+	    for (std::size_t i = 0; i < result.size(); i += 3) {
+		  for (int corner = 0; corner < 3; ++corner) {
+			unsigned int a = result[i + corner];
+			unsigned int b = result[i + (corner + 1) % 3];
+			// every interior edge shows up twice, keep one of them;
+			// border edges show up once but cannot collapse anyway
+			if (a > b) {
+			      continue;
+			}
+			Quadric q = quadrics[a];
+			q.add(quadrics[b]);
+			Collapse best{a, b, HUGE_VAL};
+			if (!locked[a]) {
+			      best.cost = q.evaluate(positions[b]);
+			}
+			if (!locked[b]) {
+			      double cost = q.evaluate(positions[a]);
+			      if (cost < best.cost) {
+				    best = Collapse{b, a, cost};
+			      }
+			}
+			if (best.cost <= maxCost) {
+			      collapses.push_back(best);
+			}
+		  }
+	    }
+	    if (collapses.empty()) {
+		  break;
+	    }
+	    std::sort(collapses.begin(), collapses.end(),
+		      [](const Collapse& l, const Collapse& r) {
+			    return l.cost < r.cost;
+		      });
+
+	    // apply independent collapses, each one removes about two
+	    // triangles
+	    std::iota(remap.begin(), remap.end(), 0U);
+	    std::fill(touched.begin(), touched.end(), false);
+	    std::size_t removable = (result.size() - targetIndexCount) / 3;
+	    std::size_t removed = 0;
+	    for (const Collapse& collapse : collapses) {
+		  if (removed >= removable) {
+			break;
+		  }
+		  if (touched[collapse.from] || touched[collapse.to]) {
+			continue;
+		  }
+		  // moving from onto to must not flip any triangle that stays
+		  bool flips = false;
+		  unsigned int first = triangleOffsets[collapse.from];
+		  unsigned int last = triangleOffsets[collapse.from + 1];
+		  for (unsigned int t = first; t < last && !flips; ++t) {
+			const unsigned int* triangle =
+			    &result[vertexTriangles[t] * 3];
+			if (triangle[0] == collapse.to ||
+			    triangle[1] == collapse.to ||
+			    triangle[2] == collapse.to) {
+			      continue;
+			}
+			std::array<glm::vec3, 3> corners;
+			for (int c = 0; c < 3; ++c) {
+			      corners[c] = positions[triangle[c]];
+			}
+			glm::vec3 before = triangleNormal(corners[0], corners[1],
+							  corners[2]);
+			for (int c = 0; c < 3; ++c) {
+			      if (triangle[c] == collapse.from) {
+				    corners[c] = positions[collapse.to];
+			      }
+			}
+			glm::vec3 after = triangleNormal(corners[0], corners[1],
+							 corners[2]);
+			flips = glm::dot(before, after) <= 0.0F;
+		  }
+		  if (flips) {
+			continue;
+		  }
+
+		  remap[collapse.from] = collapse.to;
+		  quadrics[collapse.to].add(quadrics[collapse.from]);
+		  passError = std::max(passError, collapse.cost);
+		  // the neighbourhood changed, its other collapses wait for the
+		  // next pass
+		  for (unsigned int t = first; t < last; ++t) {
+			const unsigned int* triangle =
+			    &result[vertexTriangles[t] * 3];
+			for (int c = 0; c < 3; ++c) {
+			      touched[triangle[c]] = true;
+			}
+		  }
+		  removed += 2;
+	    }
+	    if (removed == 0) {
+		  break;
+	    }
+
+	    std::size_t kept = 0;
+	    for (std::size_t t = 0; t < triangleCount; ++t) {
+		  unsigned int a = remap[result[t * 3]];
+		  unsigned int b = remap[result[t * 3 + 1]];
+		  unsigned int c = remap[result[t * 3 + 2]];
+		  if (a == b || b == c || c == a) {
+			continue;
+		  }
+		  result[kept++] = a;
+		  result[kept++] = b;
+		  result[kept++] = c;
+	    }
+	    result.resize(kept);
+      }
+
+      resultError = static_cast<float>(std::sqrt(passError)) / radius;
+      return result;
+}
+
+}  // namespace rg
@@ -0,0 +1,259 @@
+#include <rg/model_cache.h>
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace rg
+{
+namespace
+{
+constexpr char MAGIC[4] = {'R', 'G', 'M', 'C'};
+// sections start at multiples of this, so the vertex and index data can
+// be read in place
+constexpr std::size_t ALIGNMENT = 8;
+
+struct FileHeader {
+      char magic[4];
+      std::uint32_t version;
+      std::uint64_t sourceHash;
+      std::uint64_t settingsHash;
+      std::uint32_t meshCount;
+      std::uint32_t reserved;
+};
+
+auto align(std::size_t offset) -> std::size_t
+{
+      return (offset + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// Bounds checked sequential reads from a mapping.
+class Reader
+{
+    public:
+      explicit Reader(std::span<const std::byte> data) : m_data(data) {}
+
+      template <typename T>
+      auto read(T& value) -> bool
+      {
+	    if (m_offset + sizeof(T) > m_data.size()) {
+		  return false;
+	    }
+	    std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+	    m_offset += sizeof(T);
+	    return true;
+      }
+
+      auto readString(std::uint32_t length, std::string& value) -> bool
+      {
+	    if (m_offset + length > m_data.size()) {
+		  return false;
+	    }
+	    value.assign(reinterpret_cast<const char*>(m_data.data()) + m_offset,
+			 length);
+	    m_offset += length;
+	    return true;
+      }
+
+      // an aligned section of size bytes, read in place
+      auto section(std::size_t size, std::span<const std::byte>& value) -> bool
+      {
+	    m_offset = align(m_offset);
+	    if (m_offset + size > m_data.size()) {
+		  return false;
+	    }
+	    value = m_data.subspan(m_offset, size);
+	    m_offset += size;
+	    return true;
+      }
+
+    private:
+      std::span<const std::byte> m_data;
+      std::size_t m_offset = 0;
+};
+
+template <typename T>
+void append(std::vector<std::byte>& out, const T& value)
+{
+      const auto* bytes = reinterpret_cast<const std::byte*>(&value);
+      out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void appendSection(std::vector<std::byte>& out,
+		   std::span<const std::byte> data)
+{
+      out.resize(align(out.size()));
+      out.insert(out.end(), data.begin(), data.end());
+}
+}  // namespace
+
+MappedFile::MappedFile(const std::string& path)
+{
+      int descriptor = ::open(path.c_str(), O_RDONLY);
+      if (descriptor < 0) {
+	    return;
+      }
+      struct stat status {};
+      if (fstat(descriptor, &status) == 0 && status.st_size > 0) {
+	    void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE,
+			      descriptor, 0);
+	    if (data != MAP_FAILED) {
+		  m_data = data;
+		  m_size = status.st_size;
+	    }
+      }
+      // the mapping keeps the file alive on its own
+      ::close(descriptor);
+}
+
+MappedFile::~MappedFile()
+{
+      if (m_data != nullptr) {
+	    munmap(m_data, m_size);
+      }
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_size(std::exchange(other.m_size, 0))
+{
+}
+
+auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile&
+{
+      if (this != &other) {
+	    if (m_data != nullptr) {
+		  munmap(m_data, m_size);
+	    }
+	    m_data = std::exchange(other.m_data, nullptr);
+	    m_size = std::exchange(other.m_size, 0);
+      }
+      return *this;
+}
+
+auto hashBytes(const void* data, std::size_t size, std::uint64_t hash)
+    -> std::uint64_t
+{
+      const auto* bytes = static_cast<const unsigned char*>(data);
+      for (std::size_t i = 0; i < size; ++i) {
+	    hash ^= bytes[i];
+	    hash *= 0x100000001b3ULL;
+      }
+      return hash;
+}
+
+auto hashFile(const std::string& path, std::uint64_t hash) -> std::uint64_t
+{
+      MappedFile file(path);
+      if (!file.valid()) {
+	    return 0;
+      }
+      return hashBytes(file.data(), file.size(), hash);
+}
+
+auto ModelCache::open(const std::string& path, std::uint64_t sourceHash,
+		      std::uint64_t settingsHash) -> bool
+{
+      close();
+      m_file = MappedFile(path);
+      if (!m_file.valid()) {
+	    return false;
+      }
+
+      Reader reader({m_file.data(), m_file.size()});
+      FileHeader header{};
+      if (!reader.read(header) ||
+	  std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+	  header.version != VERSION || header.sourceHash != sourceHash ||
+	  header.settingsHash != settingsHash ||
+	  header.meshCount > m_file.size() / sizeof(CookedMeshHeader)) {
+	    close();
+	    return false;
+      }
+
+      m_meshes.resize(header.meshCount);
+      for (CookedMesh& mesh : m_meshes) {
+	    bool valid = reader.read(mesh.header) &&
+			 mesh.header.lodCount > 0 &&
+			 mesh.header.lodCount <= MAX_MESH_LODS;
+	    mesh.textures.resize(valid ? mesh.header.textureCount : 0);
+	    for (CookedTexture& texture : mesh.textures) {
+		  std::uint32_t typeLength = 0;
+		  std::uint32_t pathLength = 0;
+		  valid = valid && reader.read(typeLength) &&
+			  reader.read(pathLength) &&
+			  reader.readString(typeLength, texture.type) &&
+			  reader.readString(pathLength, texture.path);
+	    }
+	    std::size_t indexSize = mesh.header.indexType == GL_UNSIGNED_SHORT
+					? sizeof(std::uint16_t)
+					: sizeof(std::uint32_t);
+	    valid = valid &&
+		    reader.section(std::size_t{mesh.header.vertexCount} *
+				       mesh.header.vertexSize,
+				   mesh.vertexData) &&
+		    reader.section(mesh.header.indexCount * indexSize,
+				   mesh.indexData);
+	    if (!valid) {
+		  close();
+		  return false;
+	    }
+      }
+      return true;
+}
+
+void ModelCache::close()
+{
+      m_meshes.clear();
+      m_file = MappedFile();
+}
+
+auto ModelCache::write(const std::string& path, std::uint64_t sourceHash,
+		       std::uint64_t settingsHash,
+		       std::span<const CookedMesh> meshes) -> bool
+{
+      std::vector<std::byte> out;
+      FileHeader header{};
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.sourceHash = sourceHash;
+      header.settingsHash = settingsHash;
+      header.meshCount = meshes.size();
+      append(out, header);
+      for (const CookedMesh& mesh : meshes) {
+	    CookedMeshHeader meshHeader = mesh.header;
+	    meshHeader.textureCount = mesh.textures.size();
+	    append(out, meshHeader);
+	    for (const CookedTexture& texture : mesh.textures) {
+		  append(out, static_cast<std::uint32_t>(texture.type.size()));
+		  append(out, static_cast<std::uint32_t>(texture.path.size()));
+		  const auto* type =
+		      reinterpret_cast<const std::byte*>(texture.type.data());
+		  out.insert(out.end(), type, type + texture.type.size());
+		  const auto* name =
+		      reinterpret_cast<const std::byte*>(texture.path.data());
+		  out.insert(out.end(), name, name + texture.path.size());
+	    }
+	    appendSection(out, mesh.vertexData);
+	    appendSection(out, mesh.indexData);
+      }
+
+      std::string temporary = path + ".tmp";
+      {
+	    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	    if (!file.write(reinterpret_cast<const char*>(out.data()),
+			    out.size())) {
+		  return false;
+	    }
+      }
+      return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+}  // namespace rg
@@ -0,0 +1,160 @@
+#include <rg/program_cache.h>
+
+#include <glad/glad.h>
+#include <rg/gl_extensions.h>
+#include <rg/model_cache.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace rg
+{
+namespace
+{
+constexpr char MAGIC[4] = {'R', 'G', 'P', 'B'};
+constexpr std::uint32_t VERSION = 1;
+
+struct FileHeader {
+      char magic[4];
+      std::uint32_t version;
+      std::uint64_t key;
+      std::uint32_t binaryFormat;
+      std::uint32_t length;
+};
+
+auto millisecondsSince(std::chrono::steady_clock::time_point start) -> double
+{
+      return std::chrono::duration<double, std::milli>(
+		 std::chrono::steady_clock::now() - start)
+	  .count();
+}
+}  // namespace
+
+auto ProgramCache::available() const -> bool
+{
+      return enabled && glExtensions().programBinaries;
+}
+
+auto ProgramCache::key(std::span<const std::string> sources) const
+    -> std::uint64_t
+{
+      std::uint64_t hash = hashBytes(MAGIC, sizeof(MAGIC));
+      for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+	    const auto* value =
+		reinterpret_cast<const char*>(glGetString(name));
+	    if (value != nullptr) {
+		  hash = hashBytes(value, std::strlen(value), hash);
+	    }
+      }
+      for (const std::string& source : sources) {
+	    // the length keeps sources that only differ in where one stage
+	    // ends apart
+	    std::size_t length = source.size();
+	    hash = hashBytes(&length, sizeof(length), hash);
+	    hash = hashBytes(source.data(), source.size(), hash);
+      }
+      return hash;
+}
+
+auto ProgramCache::pathOf(std::uint64_t key) const -> std::string
+{
+      char name[32];
+      std::snprintf(name, sizeof(name), "%016llx.bin",
+		    static_cast<unsigned long long>(key));
+      return directory + '/' + name;
+}
+
+auto ProgramCache::load(std::uint64_t key) -> unsigned int
+{
+      if (!available()) {
+	    return 0;
+      }
+      auto start = std::chrono::steady_clock::now();
+      MappedFile file(pathOf(key));
+      FileHeader header{};
+      if (!file.valid() || file.size() < sizeof(header)) {
+	    return 0;
+      }
+      std::memcpy(&header, file.data(), sizeof(header));
+      if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+	  header.version != VERSION || header.key != key ||
+	  sizeof(header) + header.length > file.size()) {
+	    return 0;
+      }
+
+      unsigned int program = glCreateProgram();
+      glExtensions().programBinary(program, header.binaryFormat,
+				   file.data() + sizeof(header),
+				   header.length);
+      GLint linked = GL_FALSE;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      if (linked == GL_FALSE) {
+	    // a driver may refuse binaries of its own, the caller compiles
+	    glDeleteProgram(program);
+	    ++m_stats.rejected;
+	    return 0;
+      }
+      ++m_stats.loaded;
+      m_stats.loadMilliseconds += millisecondsSince(start);
+      return program;
+}
+
+void ProgramCache::prepare(unsigned int program)
+{
+      if (available()) {
+	    glExtensions().programParameteri(
+		program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      }
+}
+
+void ProgramCache::store(unsigned int program, std::uint64_t key,
+			 double milliseconds)
+{
+      ++m_stats.compiled;
+      m_stats.compileMilliseconds += milliseconds;
+      GLint linked = GL_FALSE;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+      GLint length = 0;
+      if (available() && linked != GL_FALSE) {
+	    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+      }
+      if (length <= 0) {
+	    return;
+      }
+
+      FileHeader header{};
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.key = key;
+      std::vector<char> binary(length);
+      GLenum binaryFormat = 0;
+      GLsizei written = 0;
+      glExtensions().getProgramBinary(program, length, &written,
+				      &binaryFormat, binary.data());
+      header.binaryFormat = binaryFormat;
+      header.length = written;
+
+      std::error_code error;
+      std::filesystem::create_directories(directory, error);
+      std::string path = pathOf(key);
+      std::string temporary = path + ".tmp";
+      {
+	    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	    file.write(binary.data(), written);
+	    if (!file) {
+		  std::cout << "ERROR::SHADER:: could not write " << path
+			    << '\n';
+		  std::remove(temporary.c_str());
+		  return;
+	    }
+      }
+      std::rename(temporary.c_str(), path.c_str());
+}
+
+}  // namespace rg
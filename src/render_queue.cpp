@@ -0,0 +1,280 @@
+#include <rg/render_queue.h>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+#include <rg/gl_extensions.h>
+#include <rg/service_locator.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace rg
+{
+namespace
+{
+constexpr int PASS_SHIFT = 62;
+constexpr std::uint64_t SHADER_MASK = (1ULL << 10) - 1;
+constexpr std::uint64_t MATERIAL_MASK = (1ULL << 14) - 1;
+constexpr std::uint64_t MESH_MASK = (1ULL << 12) - 1;
+constexpr std::uint64_t LOD_MASK = (1ULL << 2) - 1;
+constexpr std::uint64_t DEPTH_MASK = (1ULL << 24) - 1;
+
+// Non-negative floats order the same way as their bit patterns, so the top 24
+// bits of the pattern are a monotonic depth value without a far plane to
+// normalize against.
+auto quantizeDepth(float depth) -> std::uint64_t
+{
+      depth = std::max(depth, 0.0F);
+      return (std::bit_cast<std::uint32_t>(depth) >> 8) & DEPTH_MASK;
+}
+}  // namespace
+
+void RenderQueue::begin(const glm::mat4& view, const glm::mat4& projection)
+{
+      m_view = view;
+      m_frustum = Frustum::fromMatrix(projection * view);
+      m_packets.clear();
+      m_keys.clear();
+      m_bounds.clear();
+      m_stats = FrameStats{};
+}
+
+void RenderQueue::submit(RenderPass pass, Shader& shader, Mesh& mesh,
+			 const glm::mat4& model, unsigned int lod, float fade)
+{
+      // ids wrap around when there are more shaders, materials or meshes
+      // than their fields can hold; that only costs batching, merging
+      // compares the packets themselves
+      std::uint64_t state =
+	  (shaderId(shader) & SHADER_MASK) << 28 |
+	  (materialId(mesh.material) & MATERIAL_MASK) << 14 |
+	  (meshId(mesh) & MESH_MASK) << 2 | (lod & LOD_MASK);
+      BoundingSphere sphere = transform(mesh.sphere, model);
+      std::uint64_t depth =
+	  quantizeDepth(-(m_view * glm::vec4(sphere.center, 1.0F)).z);
+
+      std::uint64_t key = static_cast<std::uint64_t>(pass) << PASS_SHIFT;
+      if (pass == RenderPass::Transparent) {
+	    key |= (DEPTH_MASK - depth) << 38 | state;
+      } else {
+	    key |= state << 24 | depth;
+      }
+
+      m_keys.push_back(key);
+      m_bounds.add(transform(mesh.bounds, model));
+      Packet packet{&shader, &mesh, lod, model};
+      packet.model[0][3] = fade;
+      m_packets.push_back(packet);
+}
+
+void RenderQueue::flush()
+{
+      m_stats.packets = m_packets.size();
+      cullPackets();
+      m_stats.visible = m_packets.size();
+      m_stats.culled = m_stats.packets - m_stats.visible;
+      if (m_packets.empty()) {
+	    return;
+      }
+      sortKeys();
+
+      m_instances.clear();
+      for (std::uint32_t index : m_order) {
+	    m_instances.push_back(m_packets[index].model);
+      }
+      m_instanceBuffer.upload(m_instances);
+
+      const bool multiDraw = glExtensions().multiDrawIndirect;
+      int currentPass = -1;
+      std::size_t first = 0;
+      while (first < m_order.size()) {
+	    const Packet& packet = m_packets[m_order[first]];
+	    int pass = passOf(first);
+	    std::size_t last = runEnd(first);
+	    if (pass != currentPass) {
+		  setPassState(static_cast<RenderPass>(pass));
+		  currentPass = pass;
+	    }
+	    packet.shader->use();
+
+	    // the following runs join a multi draw while only their mesh or
+	    // lod differs, their geometry lives in the same arena and they
+	    // decode their vertices the same way
+	    m_commands.clear();
+	    m_commands.push_back(
+		packet.mesh->IndirectCommand(packet.lod, last - first, first));
+	    std::size_t groupLast = last;
+	    while (multiDraw && groupLast < m_order.size()) {
+		  const Packet& next = m_packets[m_order[groupLast]];
+		  if (passOf(groupLast) != pass ||
+		      next.shader != packet.shader ||
+		      !sharesDrawState(*packet.mesh, *next.mesh)) {
+			break;
+		  }
+		  if (!sharesQuantization(*packet.mesh, *next.mesh)) {
+			++m_stats.quantizationSplits;
+			break;
+		  }
+		  std::size_t nextLast = runEnd(groupLast);
+		  m_commands.push_back(next.mesh->IndirectCommand(
+		      next.lod, nextLast - groupLast, groupLast));
+		  groupLast = nextLast;
+	    }
+
+	    if (m_commands.size() > 1) {
+		  m_instanceBuffer.attach(packet.mesh->VAO);
+		  packet.mesh->Bind(*packet.shader);
+		  ServiceLocator::Get().getGeometryPool().multiDrawIndirect(
+		      m_commands, packet.mesh->indexType);
+		  ++m_stats.multiDraws;
+	    } else {
+		  m_instanceBuffer.attach(packet.mesh->VAO,
+					  first * sizeof(glm::mat4));
+		  packet.mesh->DrawInstanced(*packet.shader, last - first,
+					     packet.lod);
+	    }
+	    ++m_stats.batches;
+	    for (const DrawElementsIndirectCommand& command : m_commands) {
+		  m_stats.triangles +=
+		      command.count / 3 * command.instanceCount;
+	    }
+	    first = groupLast;
+      }
+      setPassState(RenderPass::Opaque);
+}
+
+auto RenderQueue::passOf(std::size_t position) const -> int
+{
+      return static_cast<int>(m_keys[m_order[position]] >> PASS_SHIFT);
+}
+
+// End of the run of packets starting at position that share shader, mesh,
+// lod and pass, which makes them one instanced draw.
+auto RenderQueue::runEnd(std::size_t position) const -> std::size_t
+{
+      const Packet& packet = m_packets[m_order[position]];
+      int pass = passOf(position);
+      std::size_t last = position + 1;
+      while (last < m_order.size()) {
+	    const Packet& next = m_packets[m_order[last]];
+	    if (next.shader != packet.shader || next.mesh != packet.mesh ||
+		next.lod != packet.lod || passOf(last) != pass) {
+		  break;
+	    }
+	    ++last;
+      }
+      return last;
+}
+
+// Whether the draws of both meshes can share one multi draw apart from the
+// quantization: same VAO, index type, vertex format and material.
+auto RenderQueue::sharesDrawState(const Mesh& mesh, const Mesh& other) -> bool
+{
+      return mesh.VAO == other.VAO && mesh.indexType == other.indexType &&
+	     mesh.vertexFormat == other.vertexFormat &&
+	     mesh.material == other.material;
+}
+
+// The quantization is a uniform set once per draw, so a multi draw can only
+// hold meshes that decode their vertices alike. Packed meshes are quantized to
+// their own bounds and only share it with their levels of detail.
+auto RenderQueue::sharesQuantization(const Mesh& mesh, const Mesh& other)
+    -> bool
+{
+      return mesh.quantization.offset == other.quantization.offset &&
+	     mesh.quantization.scale == other.quantization.scale;
+}
+
+auto RenderQueue::shaderId(const Shader& shader) -> std::uint64_t
+{
+      auto it = m_shaderIds.find(shader.ID);
+      if (it == m_shaderIds.end()) {
+	    it = m_shaderIds.emplace(shader.ID, m_shaderIds.size()).first;
+      }
+      return it->second;
+}
+
+// Meshes with the same material get the same id, so they sort next to each
+// other and the material binds are filtered.
+auto RenderQueue::materialId(const Material* material) -> std::uint64_t
+{
+      auto it = m_materialIds.find(material);
+      if (it == m_materialIds.end()) {
+	    it = m_materialIds.emplace(material, m_materialIds.size()).first;
+      }
+      return it->second;
+}
+
+auto RenderQueue::meshId(const Mesh& mesh) -> std::uint64_t
+{
+      auto it = m_meshIds.find(&mesh);
+      if (it == m_meshIds.end()) {
+	    it = m_meshIds.emplace(&mesh, m_meshIds.size()).first;
+      }
+      return it->second;
+}
+
+// Tests all packet bounds in one batch and compacts the survivors in place.
+void RenderQueue::cullPackets()
+{
+      m_bounds.cull(m_frustum, m_visible);
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < m_packets.size(); ++i) {
+	    if (m_visible[i] != 0) {
+		  m_packets[kept] = m_packets[i];
+		  m_keys[kept] = m_keys[i];
+		  ++kept;
+	    }
+      }
+      m_packets.resize(kept);
+      m_keys.resize(kept);
+}
+
+// LSD radix sort of the packet indices by key, one byte per pass. Passes in
+// which every key has the same byte are skipped, which is the common case for
+// the pass and shader bits of small scenes.
+void RenderQueue::sortKeys()
+{
+      std::size_t count = m_keys.size();
+      m_order.resize(count);
+      m_sortOrder.resize(count);
+      m_sortKeys.assign(m_keys.begin(), m_keys.end());
+      m_sortScratch.resize(count);
+      for (std::uint32_t i = 0; i < count; ++i) {
+	    m_order[i] = i;
+      }
+
+      for (int shift = 0; shift < 64; shift += 8) {
+	    std::array<std::uint32_t, 256> histogram{};
+	    for (std::uint64_t key : m_sortKeys) {
+		  ++histogram[(key >> shift) & 0xFF];
+	    }
+	    if (histogram[(m_sortKeys[0] >> shift) & 0xFF] == count) {
+		  continue;
+	    }
+	    std::uint32_t offset = 0;
+	    for (std::uint32_t& bucket : histogram) {
+		  std::uint32_t size = bucket;
+		  bucket = offset;
+		  offset += size;
+	    }
+	    for (std::size_t i = 0; i < count; ++i) {
+		  std::uint32_t& slot =
+		      histogram[(m_sortKeys[i] >> shift) & 0xFF];
+		  m_sortScratch[slot] = m_sortKeys[i];
+		  m_sortOrder[slot] = m_order[i];
+		  ++slot;
+	    }
+	    m_sortKeys.swap(m_sortScratch);
+	    m_order.swap(m_sortOrder);
+      }
+}
+
+void RenderQueue::setPassState(RenderPass pass)
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      state.setEnabled(GL_BLEND, pass == RenderPass::Transparent);
+}
+
+}  // namespace rg
@@ -18,6 +18,11 @@ void InputController::processKeyCallback(GLFWwindow* window, int key,
       keyState.glfwKeyAction = action;
 }
 
+void InputController::processMouseButtonCallback(int button, int action)
+{
+      m_keys[button].glfwKeyAction = action;
+}
+
 void InputController::update(float dt)
 {
       for (auto& key : m_keys) {
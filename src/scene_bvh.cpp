@@ -0,0 +1,279 @@
+#include <rg/scene_bvh.h>
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+
+namespace rg
+{
+namespace
+{
+constexpr int BIN_COUNT = 12;
+// cost of visiting a node relative to testing one object against its bounds
+constexpr float TRAVERSAL_COST = 0.125F;
+
+auto surfaceArea(const AABB& box) -> float
+{
+      if (box.empty()) {
+	    return 0.0F;
+      }
+      glm::vec3 size = box.max - box.min;
+      return 2.0F * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+enum class Containment { Outside, Intersecting, Inside };
+
+auto classify(const Frustum& frustum, const AABB& box) -> Containment
+{
+      glm::vec3 center = box.center();
+      glm::vec3 extent = box.extent();
+      Containment result = Containment::Inside;
+      for (const glm::vec4& plane : frustum.planes) {
+	    glm::vec3 normal(plane);
+	    float distance = glm::dot(normal, center) + plane.w;
+	    float radius = glm::dot(glm::abs(normal), extent);
+	    if (distance + radius < 0.0F) {
+		  return Containment::Outside;
+	    }
+	    if (distance - radius < 0.0F) {
+		  result = Containment::Intersecting;
+	    }
+      }
+      return result;
+}
+
+// Slab test; returns the entry parameter of the ray, or infinity on a miss.
+auto intersect(const AABB& box, const Ray& ray, const glm::vec3& inverseDirection)
+    -> float
+{
+      glm::vec3 t0 = (box.min - ray.origin) * inverseDirection;
+      glm::vec3 t1 = (box.max - ray.origin) * inverseDirection;
+      glm::vec3 near = glm::min(t0, t1);
+      glm::vec3 far = glm::max(t0, t1);
+      float entry = std::max({near.x, near.y, near.z, 0.0F});
+      float exit = std::min({far.x, far.y, far.z});
+      return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+}
+}  // namespace
+
+void SceneBVH::build(std::span<const AABB> objectBounds)
+{
+      m_nodes.clear();
+      m_objects.resize(objectBounds.size());
+      std::iota(m_objects.begin(), m_objects.end(), 0U);
+      if (objectBounds.empty()) {
+	    return;
+      }
+      std::vector<glm::vec3> centroids;
+      centroids.reserve(objectBounds.size());
+      for (const AABB& box : objectBounds) {
+	    centroids.push_back(box.center());
+      }
+      m_nodes.reserve(2 * objectBounds.size());
+      buildNode(objectBounds, centroids, 0, objectBounds.size());
+}
+
+auto SceneBVH::buildNode(std::span<const AABB> objectBounds,
+			 std::vector<glm::vec3>& centroids, std::uint32_t first,
+			 std::uint32_t count) -> std::uint32_t
+{
+      auto index = static_cast<std::uint32_t>(m_nodes.size());
+      m_nodes.emplace_back();
+
+      AABB bounds;
+      AABB centroidBounds;
+      for (std::uint32_t i = first; i < first + count; ++i) {
+	    bounds.extend(objectBounds[m_objects[i]]);
+	    centroidBounds.extend(centroids[m_objects[i]]);
+      }
+      m_nodes[index].bounds = bounds;
+      m_nodes[index].first = first;
+      m_nodes[index].count = count;
+      if (count == 1) {
+	    return index;
+      }
+
+      glm::vec3 centroidSize = centroidBounds.max - centroidBounds.min;
+      int axis = 0;
+      if (centroidSize.y > centroidSize[axis]) {
+	    axis = 1;
+      }
+      if (centroidSize.z > centroidSize[axis]) {
+	    axis = 2;
+      }
+
+      std::uint32_t middle = first + count / 2;
+      if (centroidSize[axis] > 0.0F) {
+	    struct Bin {
+		  AABB bounds;
+		  std::uint32_t count = 0;
+	    };
+	    std::array<Bin, BIN_COUNT> bins{};
+	    float scale = BIN_COUNT / centroidSize[axis];
+	    auto binOf = [&](std::uint32_t object) {
+		  int bin = static_cast<int>(
+		      (centroids[object][axis] - centroidBounds.min[axis]) *
+		      scale);
+		  return std::min(bin, BIN_COUNT - 1);
+	    };
+	    for (std::uint32_t i = first; i < first + count; ++i) {
+		  Bin& bin = bins[binOf(m_objects[i])];
+		  bin.bounds.extend(objectBounds[m_objects[i]]);
+		  ++bin.count;
+	    }
+
+	    // sweep from the right to get the cost of every suffix, then from
+	    // the left to evaluate the split after each bin
+	    std::array<float, BIN_COUNT> rightCost{};
+	    AABB rightBounds;
+	    std::uint32_t rightCount = 0;
+	    for (int bin = BIN_COUNT - 1; bin > 0; --bin) {
+		  rightBounds.extend(bins[bin].bounds);
+		  rightCount += bins[bin].count;
+		  rightCost[bin] = surfaceArea(rightBounds) * rightCount;
+	    }
+	    AABB leftBounds;
+	    std::uint32_t leftCount = 0;
+	    float bestCost = std::numeric_limits<float>::infinity();
+	    int bestSplit = -1;
+	    for (int bin = 0; bin < BIN_COUNT - 1; ++bin) {
+		  leftBounds.extend(bins[bin].bounds);
+		  leftCount += bins[bin].count;
+		  if (leftCount == 0 || leftCount == count) {
+			continue;
+		  }
+		  float cost = surfaceArea(leftBounds) * leftCount +
+			       rightCost[bin + 1];
+		  if (cost < bestCost) {
+			bestCost = cost;
+			bestSplit = bin;
+		  }
+	    }
+
+	    float parentArea = std::max(surfaceArea(bounds),
+					std::numeric_limits<float>::min());
+	    float splitCost = TRAVERSAL_COST + bestCost / parentArea;
+	    if (count <= MAX_LEAF_SIZE &&
+		(bestSplit < 0 || splitCost >= static_cast<float>(count))) {
+		  return index;
+	    }
+	    if (bestSplit >= 0) {
+		  auto* split = std::partition(
+		      m_objects.data() + first, m_objects.data() + first + count,
+		      [&](std::uint32_t object) {
+			    return binOf(object) <= bestSplit;
+		      });
+		  middle = static_cast<std::uint32_t>(split - m_objects.data());
+	    }
+      } else if (count <= MAX_LEAF_SIZE) {
+	    // all centroids coincide, no split can separate them
+	    return index;
+      }
+
+      buildNode(objectBounds, centroids, first, middle - first);
+      std::uint32_t right =
+	  buildNode(objectBounds, centroids, middle, first + count - middle);
+      m_nodes[index].right = right;
+      return index;
+}
+
+// Children always come after their parent, so walking the array backwards
+// sees both children of a node before the node itself.
+void SceneBVH::refit(std::span<const AABB> objectBounds)
+{
+      for (std::size_t i = m_nodes.size(); i-- > 0;) {
+	    Node& node = m_nodes[i];
+	    AABB bounds;
+	    if (node.leaf()) {
+		  for (std::uint32_t j = node.first; j < node.first + node.count;
+		       ++j) {
+			bounds.extend(objectBounds[m_objects[j]]);
+		  }
+	    } else {
+		  bounds.extend(m_nodes[i + 1].bounds);
+		  bounds.extend(m_nodes[node.right].bounds);
+	    }
+	    node.bounds = bounds;
+      }
+}
+
+void SceneBVH::cull(const Frustum& frustum,
+		    std::vector<std::uint32_t>& visibleObjects) const
+{
+      if (m_nodes.empty()) {
+	    return;
+      }
+      std::vector<std::uint32_t> stack{0};
+      while (!stack.empty()) {
+	    std::uint32_t index = stack.back();
+	    stack.pop_back();
+	    const Node& node = m_nodes[index];
+	    Containment containment = classify(frustum, node.bounds);
+	    if (containment == Containment::Outside) {
+		  continue;
+	    }
+	    if (containment == Containment::Inside || node.leaf()) {
+		  visibleObjects.insert(
+		      visibleObjects.end(), m_objects.begin() + node.first,
+		      m_objects.begin() + node.first + node.count);
+		  continue;
+	    }
+	    stack.push_back(node.right);
+	    stack.push_back(index + 1);
+      }
+}
+
+auto SceneBVH::raycast(const Ray& ray, std::span<const AABB> objectBounds,
+		       float& distance) const -> int
+{
+      int nearest = -1;
+      distance = std::numeric_limits<float>::infinity();
+      if (m_nodes.empty()) {
+	    return nearest;
+      }
+      glm::vec3 inverseDirection = 1.0F / ray.direction;
+
+      struct Entry {
+	    std::uint32_t node;
+	    float distance;
+      };
+      std::vector<Entry> stack{{0, intersect(m_nodes[0].bounds, ray,
+					     inverseDirection)}};
+      while (!stack.empty()) {
+	    Entry entry = stack.back();
+	    stack.pop_back();
+	    if (entry.distance >= distance) {
+		  continue;
+	    }
+	    const Node& node = m_nodes[entry.node];
+	    if (node.leaf()) {
+		  for (std::uint32_t i = node.first; i < node.first + node.count;
+		       ++i) {
+			std::uint32_t object = m_objects[i];
+			float hit = intersect(objectBounds[object], ray,
+					      inverseDirection);
+			if (hit < distance) {
+			      distance = hit;
+			      nearest = static_cast<int>(object);
+			}
+		  }
+		  continue;
+	    }
+	    // push the farther child first so the nearer one is visited first
+	    Entry left{entry.node + 1,
+		       intersect(m_nodes[entry.node + 1].bounds, ray,
+				 inverseDirection)};
+	    Entry right{node.right,
+			intersect(m_nodes[node.right].bounds, ray,
+				  inverseDirection)};
+	    if (left.distance < right.distance) {
+		  std::swap(left, right);
+	    }
+	    stack.push_back(left);
+	    stack.push_back(right);
+      }
+      return nearest;
+}
+
+}  // namespace rg
@@ -0,0 +1,84 @@
+#include <rg/shader_library.h>
+
+#include <learnopengl/shader.h>
+#include <rg/gl_extensions.h>
+#include <rg/service_locator.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace rg
+{
+
+ShaderLibrary::ShaderLibrary()
+{
+      if (glExtensions().parallelShaderCompile) {
+	    // as many compiler threads as the driver sees fit
+	    glExtensions().maxShaderCompilerThreads(0xFFFFFFFFU);
+      }
+}
+
+ShaderLibrary::~ShaderLibrary() = default;
+
+auto ShaderLibrary::add(const std::string& vertexPath,
+			const std::string& fragmentPath,
+			const std::vector<std::string>& defines) -> Handle
+{
+      if (m_pending.empty()) {
+	    m_firstAdd = std::chrono::steady_clock::now();
+      }
+      auto handle = static_cast<Handle>(m_shaders.size());
+      m_shaders.push_back(std::make_unique<Shader>(
+	  vertexPath.c_str(), fragmentPath.c_str(), defines, nullptr, false));
+      m_ready.push_back(false);
+      m_pending.push_back(handle);
+      return handle;
+}
+
+auto ShaderLibrary::update() -> unsigned int
+{
+      if (m_pending.empty()) {
+	    return 0;
+      }
+      std::erase_if(m_pending, [this](Handle handle) {
+	    if (!m_shaders[handle]->ready()) {
+		  return false;
+	    }
+	    m_ready[handle] = true;
+	    return true;
+      });
+      if (m_pending.empty()) {
+	    // warm programs were linked from cached binaries, cold ones
+	    // compiled
+	    const ProgramCache::Stats& stats =
+		ServiceLocator::Get().getProgramCache().stats();
+	    double milliseconds = std::chrono::duration<double, std::milli>(
+				      std::chrono::steady_clock::now() -
+				      m_firstAdd)
+				      .count();
+	    std::cout << "SHADER::LIBRARY:: " << m_shaders.size()
+		      << " programs ready after " << milliseconds << " ms\n";
+	    std::cout << "SHADER::CACHE:: warm: " << stats.loaded
+		      << " programs in " << stats.loadMilliseconds << " ms\n";
+	    std::cout << "SHADER::CACHE:: cold: " << stats.compiled
+		      << " programs in " << stats.compileMilliseconds
+		      << " ms, " << stats.rejected
+		      << " cached binaries rejected\n";
+      }
+      return pending();
+}
+
+auto ShaderLibrary::get(Handle handle) const -> Shader*
+{
+      return m_ready[handle] ? m_shaders[handle].get() : nullptr;
+}
+
+void ShaderLibrary::finish()
+{
+      for (Handle handle : m_pending) {
+	    m_shaders[handle]->wait();
+      }
+      update();
+}
+
+}  // namespace rg
@@ -0,0 +1,249 @@
+#include <rg/shadow_cascades.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/service_locator.h>
+#include <rg/texture_type.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+
+namespace rg
+{
+namespace
+{
+// blend of logarithmic splits, even resolution over depth, and uniform ones
+constexpr float SPLIT_LAMBDA = 0.75F;
+// how far behind a cascade casters are still drawn into it
+constexpr float CULL_DISTANCE = 100.0F;
+
+auto makeDepthArray(unsigned int size) -> unsigned int
+{
+      unsigned int texture;
+      glGenTextures(1, &texture);
+      ServiceLocator::Get().getGLState().bindTexture(
+	  SHADOW_CASCADES_UNIT, GL_TEXTURE_2D_ARRAY, texture);
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size,
+		   MAX_SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT,
+		   nullptr);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      // outside the map nothing is in shadow
+      const float border[] = {1.0F, 1.0F, 1.0F, 1.0F};
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,
+		      GL_CLAMP_TO_BORDER);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,
+		      GL_CLAMP_TO_BORDER);
+      glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+      return texture;
+}
+
+// A depth only framebuffer drawing to one layer of texture.
+auto makeLayerFramebuffer(unsigned int texture, unsigned int layer)
+    -> unsigned int
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      unsigned int framebuffer;
+      glGenFramebuffers(1, &framebuffer);
+      state.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+      glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture,
+				0, layer);
+      glDrawBuffer(GL_NONE);
+      glReadBuffer(GL_NONE);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+	    std::cout << "ERROR::FRAMEBUFFER:: Shadow cascade is not complete!"
+		      << std::endl;
+      }
+      state.bindFramebuffer(GL_FRAMEBUFFER, 0);
+      return framebuffer;
+}
+}  // namespace
+
+ShadowCascades::ShadowCascades(unsigned int size) : m_size(size)
+{
+      m_cacheTexture = makeDepthArray(size);
+      m_mapTexture = makeDepthArray(size);
+      // the map, still bound, is sampled with hardware depth comparison
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+		      GL_COMPARE_REF_TO_TEXTURE);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC,
+		      GL_LEQUAL);
+      for (unsigned int layer = 0; layer < MAX_SHADOW_CASCADES; ++layer) {
+	    m_cacheFBOs[layer] = makeLayerFramebuffer(m_cacheTexture, layer);
+	    m_mapFBOs[layer] = makeLayerFramebuffer(m_mapTexture, layer);
+      }
+      glGenQueries(TIMER_QUERIES, m_queries);
+}
+
+ShadowCascades::~ShadowCascades()
+{
+      GLState& state = ServiceLocator::Get().getGLState();
+      state.forgetTexture(m_cacheTexture);
+      state.forgetTexture(m_mapTexture);
+      glDeleteTextures(1, &m_cacheTexture);
+      glDeleteTextures(1, &m_mapTexture);
+      glDeleteFramebuffers(MAX_SHADOW_CASCADES, m_cacheFBOs);
+      glDeleteFramebuffers(MAX_SHADOW_CASCADES, m_mapFBOs);
+      glDeleteQueries(TIMER_QUERIES, m_queries);
+}
+
+void ShadowCascades::setCascadeCount(unsigned int count)
+{
+      m_count = std::clamp(count, MIN_CASCADES, MAX_SHADOW_CASCADES);
+}
+
+void ShadowCascades::update(const glm::mat4& cameraView, float fovY,
+			    float aspect, float near, float shadowDistance,
+			    const glm::vec3& lightDirection,
+			    std::uint64_t staticVersion)
+{
+      m_stats.cascades = m_count;
+      glm::mat4 cameraToWorld = glm::inverse(cameraView);
+      glm::vec3 direction = glm::normalize(lightDirection);
+      glm::vec3 up = std::abs(direction.y) > 0.99F
+			 ? glm::vec3(1.0F, 0.0F, 0.0F)
+			 : glm::vec3(0.0F, 1.0F, 0.0F);
+      glm::mat4 lightView = glm::lookAt(glm::vec3(0.0F), direction, up);
+      float tanHalfFov = std::tan(fovY * 0.5F);
+      // the sphere is enlarged so that it stays inside after its center
+      // snaps by up to half a step in x and y
+      float enlarge = 1.0F / (1.0F - 2.0F * (float)CACHE_SNAP_TEXELS /
+					 (float)m_size);
+
+      float sliceNear = near;
+      for (unsigned int i = 0; i < m_count; ++i) {
+	    float t = (float)(i + 1) / (float)m_count;
+	    float uniformSplit = near + (shadowDistance - near) * t;
+	    float logSplit = near * std::pow(shadowDistance / near, t);
+	    float sliceFar = uniformSplit +
+			     (logSplit - uniformSplit) * SPLIT_LAMBDA;
+
+	    // bounding sphere of the slice; its radius does not depend on
+	    // the camera orientation
+	    glm::vec3 corners[8];
+	    glm::vec3 center(0.0F);
+	    for (int corner = 0; corner < 8; ++corner) {
+		  float depth = corner < 4 ? sliceNear : sliceFar;
+		  float y = depth * tanHalfFov * (corner & 1 ? 1.0F : -1.0F);
+		  float x = depth * tanHalfFov * aspect *
+			    (corner & 2 ? 1.0F : -1.0F);
+		  corners[corner] = glm::vec3(
+		      cameraToWorld * glm::vec4(x, y, -depth, 1.0F));
+		  center += corners[corner] / 8.0F;
+	    }
+	    float radius = 0.0F;
+	    for (const glm::vec3& corner : corners) {
+		  radius = std::max(radius, glm::length(corner - center));
+	    }
+	    // rounded up so float noise does not move the cascade
+	    radius = std::ceil(radius * 16.0F) / 16.0F;
+
+	    float halfSize = radius * enlarge;
+	    float step = 2.0F * halfSize * (float)CACHE_SNAP_TEXELS /
+			 (float)m_size;
+	    glm::vec3 lightCenter = glm::vec3(lightView *
+					      glm::vec4(center, 1.0F));
+	    lightCenter = glm::floor(lightCenter / step + 0.5F) * step;
+
+	    Cascade& cascade = m_cascades[i];
+	    cascade.view = lightView;
+	    cascade.projection = glm::ortho(
+		lightCenter.x - halfSize, lightCenter.x + halfSize,
+		lightCenter.y - halfSize, lightCenter.y + halfSize,
+		-(lightCenter.z + halfSize), -(lightCenter.z - halfSize));
+	    cascade.cullProjection = glm::ortho(
+		lightCenter.x - halfSize, lightCenter.x + halfSize,
+		lightCenter.y - halfSize, lightCenter.y + halfSize,
+		-(lightCenter.z + halfSize + CULL_DISTANCE),
+		-(lightCenter.z - halfSize));
+	    cascade.viewProjection = cascade.projection * lightView;
+
+	    CacheState& cache = m_cache[i];
+	    if (cache.viewProjection != cascade.viewProjection ||
+		cache.staticVersion != staticVersion) {
+		  cache.viewProjection = cascade.viewProjection;
+		  cache.staticVersion = staticVersion;
+		  cache.valid = false;
+	    }
+
+	    m_block.lightSpace[i] = cascade.viewProjection;
+	    m_block.cascadeSplits[i] = sliceFar;
+	    m_block.normalOffsets[i] =
+		normalOffsetTexels * 2.0F * halfSize / (float)m_size;
+	    sliceNear = sliceFar;
+      }
+      m_block.cascadeCount = (int)m_count;
+      m_block.depthBias = depthBias;
+      m_shadowData.update(m_block);
+}
+
+void ShadowCascades::render(
+    const std::function<void(const Cascade&, ShadowCaster)>& drawCasters)
+{
+      readTimer();
+      glBeginQuery(GL_TIME_ELAPSED, m_queries[m_nextQuery]);
+
+      GLState& state = ServiceLocator::Get().getGLState();
+      std::array<GLint, 4> viewport = state.viewport();
+      state.viewport(0, 0, m_size, m_size);
+      state.enable(GL_DEPTH_TEST);
+      state.enable(GL_DEPTH_CLAMP);
+      // slope scaled, against acne on surfaces at grazing angles
+      state.enable(GL_POLYGON_OFFSET_FILL);
+      state.polygonOffset(1.5F, 2.0F);
+
+      for (unsigned int i = 0; i < m_count; ++i) {
+	    const Cascade& cascade = m_cascades[i];
+	    CacheState& cache = m_cache[i];
+	    if (cache.valid) {
+		  ++m_stats.cacheHits;
+	    } else {
+		  state.bindFramebuffer(GL_FRAMEBUFFER, m_cacheFBOs[i]);
+		  glClear(GL_DEPTH_BUFFER_BIT);
+		  drawCasters(cascade, ShadowCaster::Static);
+		  cache.valid = true;
+		  ++m_stats.cacheMisses;
+	    }
+	    state.bindFramebuffer(GL_READ_FRAMEBUFFER, m_cacheFBOs[i]);
+	    state.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_mapFBOs[i]);
+	    glBlitFramebuffer(0, 0, m_size, m_size, 0, 0, m_size, m_size,
+			      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	    state.bindFramebuffer(GL_FRAMEBUFFER, m_mapFBOs[i]);
+	    drawCasters(cascade, ShadowCaster::Dynamic);
+      }
+
+      state.disable(GL_POLYGON_OFFSET_FILL);
+      state.disable(GL_DEPTH_CLAMP);
+      state.viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+      glEndQuery(GL_TIME_ELAPSED);
+      m_queryIssued[m_nextQuery] = true;
+      m_nextQuery = (m_nextQuery + 1) % TIMER_QUERIES;
+}
+
+void ShadowCascades::bind() const
+{
+      ServiceLocator::Get().getGLState().bindTexture(
+	  SHADOW_CASCADES_UNIT, GL_TEXTURE_2D_ARRAY, m_mapTexture);
+}
+
+// The query about to be reused was issued TIMER_QUERIES - 1 frames ago and
+// is usually done; when it is not the sample is dropped rather than waited
+// for.
+void ShadowCascades::readTimer()
+{
+      if (!m_queryIssued[m_nextQuery]) {
+	    return;
+      }
+      unsigned int query = m_queries[m_nextQuery];
+      GLint available = GL_FALSE;
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available == GL_FALSE) {
+	    return;
+      }
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+      m_stats.gpuMilliseconds = (double)nanoseconds / 1.0e6;
+}
+
+}  // namespace rg
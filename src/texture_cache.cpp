@@ -0,0 +1,128 @@
+#include <rg/texture_cache.h>
+
+#include <rg/model_cache.h>
+#include <rg/service_locator.h>
+
+#include <filesystem>
+
+namespace rg
+{
+namespace
+{
+// one spelling per file, as far as the file system can tell
+auto canonicalPath(const std::string& path) -> std::string
+{
+      std::error_code error;
+      std::filesystem::path canonical =
+	  std::filesystem::weakly_canonical(path, error);
+      if (error) {
+	    return std::filesystem::path(path).lexically_normal().string();
+      }
+      return canonical.string();
+}
+}  // namespace
+
+auto TextureCache::acquire(const std::string& path, TextureUsage usage,
+			   bool clampTransparent) -> unsigned int
+{
+      std::string pathKey = canonicalPath(path) + '#' +
+			    std::to_string(static_cast<int>(usage)) +
+			    (clampTransparent ? "#clamp" : "");
+      auto byPath = m_byPath.find(pathKey);
+      if (byPath != m_byPath.end()) {
+	    ++m_hits;
+	    ++m_entries[byPath->second].references;
+	    return byPath->second;
+      }
+
+      std::uint64_t contentKey = 0;
+      if (matchContents) {
+	    contentKey = hashFile(path);
+	    if (contentKey != 0) {
+		  contentKey = hashBytes(&usage, sizeof(usage), contentKey);
+		  contentKey = hashBytes(&clampTransparent,
+					 sizeof(clampTransparent), contentKey);
+	    }
+      }
+      if (contentKey != 0) {
+	    auto byContent = m_byContent.find(contentKey);
+	    if (byContent != m_byContent.end()) {
+		  ++m_hits;
+		  ++m_contentHits;
+		  // later loads under this name skip the hash
+		  m_byPath.emplace(pathKey, byContent->second);
+		  ++m_entries[byContent->second].references;
+		  return byContent->second;
+	    }
+      }
+
+      ++m_misses;
+      unsigned int texture =
+	  ServiceLocator::Get().getTextureLoader().load(path, usage,
+							clampTransparent);
+      m_byPath.emplace(pathKey, texture);
+      if (contentKey != 0) {
+	    m_byContent.emplace(contentKey, texture);
+      }
+      m_entries[texture] = Entry{1, contentKey};
+      return texture;
+}
+
+auto TextureCache::acquirePacked(const std::vector<ChannelSource>& channels)
+    -> unsigned int
+{
+      std::string pathKey = "packed";
+      for (const ChannelSource& channel : channels) {
+	    pathKey += '#' + (channel.path.empty()
+				  ? std::to_string(channel.value)
+				  : canonicalPath(channel.path));
+      }
+      auto byPath = m_byPath.find(pathKey);
+      if (byPath != m_byPath.end()) {
+	    ++m_hits;
+	    ++m_entries[byPath->second].references;
+	    return byPath->second;
+      }
+
+      ++m_misses;
+      unsigned int texture =
+	  ServiceLocator::Get().getTextureLoader().loadPacked(channels);
+      m_byPath.emplace(pathKey, texture);
+      m_entries[texture] = Entry{1, 0};
+      return texture;
+}
+
+void TextureCache::release(unsigned int texture)
+{
+      auto entry = m_entries.find(texture);
+      if (entry == m_entries.end() || --entry->second.references > 0) {
+	    return;
+      }
+      // every path that led to the texture, including aliases found by
+      // content
+      std::erase_if(m_byPath, [texture](const auto& alias) {
+	    return alias.second == texture;
+      });
+      if (entry->second.contentKey != 0) {
+	    m_byContent.erase(entry->second.contentKey);
+      }
+      m_entries.erase(entry);
+      ServiceLocator::Get().getTextureLoader().release(texture);
+}
+
+auto TextureCache::stats() const -> Stats
+{
+      Stats stats;
+      stats.textures = m_entries.size();
+      stats.hits = m_hits;
+      stats.contentHits = m_contentHits;
+      stats.misses = m_misses;
+      const TextureLoader& loader = ServiceLocator::Get().getTextureLoader();
+      for (const auto& [texture, entry] : m_entries) {
+	    stats.references += entry.references;
+	    stats.residentBytes += loader.uploadedBytes(texture);
+      }
+      return stats;
+}
+
+}  // namespace rg
@@ -0,0 +1,384 @@
+#include <rg/texture_compression.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace rg
+{
+namespace
+{
+constexpr std::uint32_t fourCC(char a, char b, char c, char d)
+{
+      return std::uint32_t(a) | std::uint32_t(b) << 8 |
+	     std::uint32_t(c) << 16 | std::uint32_t(d) << 24;
+}
+
+constexpr std::uint32_t DDS_MAGIC = fourCC('D', 'D', 'S', ' ');
+// marks files written by writeDDS in the reserved header words
+constexpr std::uint32_t ENCODER_TAG = fourCC('R', 'G', 'T', 'X');
+// larger than any texture GL accepts, guards the size computations
+constexpr std::uint32_t MAX_DIMENSION = 1 << 16;
+
+constexpr std::uint32_t DDSD_CAPS = 0x1;
+constexpr std::uint32_t DDSD_HEIGHT = 0x2;
+constexpr std::uint32_t DDSD_WIDTH = 0x4;
+constexpr std::uint32_t DDSD_PIXELFORMAT = 0x1000;
+constexpr std::uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+constexpr std::uint32_t DDSD_LINEARSIZE = 0x80000;
+constexpr std::uint32_t DDPF_FOURCC = 0x4;
+constexpr std::uint32_t DDSCAPS_COMPLEX = 0x8;
+constexpr std::uint32_t DDSCAPS_TEXTURE = 0x1000;
+constexpr std::uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+struct DDSPixelFormat {
+      std::uint32_t size;
+      std::uint32_t flags;
+      std::uint32_t fourCC;
+      std::uint32_t rgbBitCount;
+      std::uint32_t bitMasks[4];
+};
+
+struct DDSHeader {
+      std::uint32_t magic;
+      std::uint32_t size;
+      std::uint32_t flags;
+      std::uint32_t height;
+      std::uint32_t width;
+      std::uint32_t pitchOrLinearSize;
+      std::uint32_t depth;
+      std::uint32_t mipMapCount;
+      // [0] ENCODER_TAG, [1] encoder version, [2] and [3] the source hash
+      std::uint32_t reserved1[11];
+      DDSPixelFormat pixelFormat;
+      std::uint32_t caps[4];
+      std::uint32_t reserved2;
+};
+static_assert(sizeof(DDSHeader) == 128);
+
+auto fourCCOf(BlockFormat format) -> std::uint32_t
+{
+      switch (format) {
+      case BlockFormat::BC1:
+	    return fourCC('D', 'X', 'T', '1');
+      case BlockFormat::BC3:
+	    return fourCC('D', 'X', 'T', '5');
+      case BlockFormat::BC4:
+	    return fourCC('A', 'T', 'I', '1');
+      case BlockFormat::BC5:
+	    return fourCC('A', 'T', 'I', '2');
+      }
+      return 0;
+}
+
+// the 16 texels of the block at (blockX, blockY) as RGBA; texels past the
+// edges repeat the last row or column
+void fetchBlock(const unsigned char* pixels, int width, int height,
+		int components, int blockX, int blockY,
+		unsigned char block[16][4])
+{
+      for (int y = 0; y < 4; ++y) {
+	    int row = std::min(blockY * 4 + y, height - 1);
+	    for (int x = 0; x < 4; ++x) {
+		  int column = std::min(blockX * 4 + x, width - 1);
+		  const unsigned char* texel =
+		      pixels +
+		      (std::size_t(row) * width + column) * components;
+		  unsigned char* out = block[y * 4 + x];
+		  for (int c = 0; c < 4; ++c) {
+			out[c] = c < components ? texel[c]
+						: (c == 3 ? 255 : texel[0]);
+		  }
+	    }
+      }
+}
+
+auto to565(float r, float g, float b) -> std::uint16_t
+{
+      auto quantize = [](float value, int bits) {
+	    int maximum = (1 << bits) - 1;
+	    return std::clamp(int(std::lround(value / 255.0F * maximum)), 0,
+			      maximum);
+      };
+      return std::uint16_t(quantize(r, 5) << 11 | quantize(g, 6) << 5 |
+			   quantize(b, 5));
+}
+
+void from565(std::uint16_t color, int rgb[3])
+{
+      int r = color >> 11 & 31;
+      int g = color >> 5 & 63;
+      int b = color & 31;
+      rgb[0] = r << 3 | r >> 2;
+      rgb[1] = g << 2 | g >> 4;
+      rgb[2] = b << 3 | b >> 2;
+}
+
+// Four color BC1 block. The endpoints span the projection of the texels on
+// the principal axis of their colors.
+void encodeColorBlock(const unsigned char block[16][4], unsigned char* out)
+{
+      float mean[3] = {};
+      for (int i = 0; i < 16; ++i) {
+	    for (int c = 0; c < 3; ++c) {
+		  mean[c] += block[i][c] / 16.0F;
+	    }
+      }
+      float covariance[6] = {};
+      for (int i = 0; i < 16; ++i) {
+	    float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1],
+			  block[i][2] - mean[2]};
+	    covariance[0] += d[0] * d[0];
+	    covariance[1] += d[0] * d[1];
+	    covariance[2] += d[0] * d[2];
+	    covariance[3] += d[1] * d[1];
+	    covariance[4] += d[1] * d[2];
+	    covariance[5] += d[2] * d[2];
+      }
+      // a few power iterations are plenty for a 3x3 matrix
+      float axis[3] = {1.0F, 1.0F, 1.0F};
+      for (int iteration = 0; iteration < 8; ++iteration) {
+	    float next[3] = {
+		covariance[0] * axis[0] + covariance[1] * axis[1] +
+		    covariance[2] * axis[2],
+		covariance[1] * axis[0] + covariance[3] * axis[1] +
+		    covariance[4] * axis[2],
+		covariance[2] * axis[0] + covariance[4] * axis[1] +
+		    covariance[5] * axis[2]};
+	    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] +
+				     next[2] * next[2]);
+	    if (length < 1e-6F) {
+		  break;
+	    }
+	    for (int c = 0; c < 3; ++c) {
+		  axis[c] = next[c] / length;
+	    }
+      }
+      float low = 0.0F;
+      float high = 0.0F;
+      for (int i = 0; i < 16; ++i) {
+	    float t = (block[i][0] - mean[0]) * axis[0] +
+		      (block[i][1] - mean[1]) * axis[1] +
+		      (block[i][2] - mean[2]) * axis[2];
+	    low = std::min(low, t);
+	    high = std::max(high, t);
+      }
+      std::uint16_t color0 =
+	  to565(mean[0] + axis[0] * high, mean[1] + axis[1] * high,
+		mean[2] + axis[2] * high);
+      std::uint16_t color1 =
+	  to565(mean[0] + axis[0] * low, mean[1] + axis[1] * low,
+		mean[2] + axis[2] * low);
+      // color0 > color1 selects the four color mode
+      if (color0 < color1) {
+	    std::swap(color0, color1);
+      }
+
+      std::uint32_t indices = 0;
+      if (color0 != color1) {
+	    int palette[4][3];
+	    from565(color0, palette[0]);
+	    from565(color1, palette[1]);
+	    for (int c = 0; c < 3; ++c) {
+		  palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		  palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	    }
+	    for (int i = 0; i < 16; ++i) {
+		  int best = 0;
+		  int bestDistance = 1 << 30;
+		  for (int p = 0; p < 4; ++p) {
+			int distance = 0;
+			for (int c = 0; c < 3; ++c) {
+			      int d = block[i][c] - palette[p][c];
+			      distance += d * d;
+			}
+			if (distance < bestDistance) {
+			      best = p;
+			      bestDistance = distance;
+			}
+		  }
+		  indices |= std::uint32_t(best) << (2 * i);
+	    }
+      }
+      std::memcpy(out, &color0, 2);
+      std::memcpy(out + 2, &color1, 2);
+      std::memcpy(out + 4, &indices, 4);
+}
+
+// Eight value BC4 block of one channel of the texels.
+void encodeChannelBlock(const unsigned char block[16][4], int channel,
+			unsigned char* out)
+{
+      int low = 255;
+      int high = 0;
+      for (int i = 0; i < 16; ++i) {
+	    low = std::min<int>(low, block[i][channel]);
+	    high = std::max<int>(high, block[i][channel]);
+      }
+      out[0] = high;
+      out[1] = low;
+      std::uint64_t indices = 0;
+      if (high > low) {
+	    int palette[8] = {high, low};
+	    for (int p = 2; p < 8; ++p) {
+		  palette[p] = ((8 - p) * high + (p - 1) * low) / 7;
+	    }
+	    for (int i = 0; i < 16; ++i) {
+		  int best = 0;
+		  int bestDistance = 256;
+		  for (int p = 0; p < 8; ++p) {
+			int distance = std::abs(block[i][channel] - palette[p]);
+			if (distance < bestDistance) {
+			      best = p;
+			      bestDistance = distance;
+			}
+		  }
+		  indices |= std::uint64_t(best) << (3 * i);
+	    }
+      }
+      for (int byte = 0; byte < 6; ++byte) {
+	    out[2 + byte] = indices >> (8 * byte) & 0xFF;
+      }
+}
+}  // namespace
+
+auto blockBytes(BlockFormat format) -> std::size_t
+{
+      return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8
+								      : 16;
+}
+
+auto compressedSize(BlockFormat format, int width, int height) -> std::size_t
+{
+      return std::size_t((width + 3) / 4) * ((height + 3) / 4) *
+	     blockBytes(format);
+}
+
+auto compressImage(const unsigned char* pixels, int width, int height,
+		   int components, BlockFormat format)
+    -> std::vector<unsigned char>
+{
+      std::vector<unsigned char> out(compressedSize(format, width, height));
+      unsigned char* next = out.data();
+      unsigned char block[16][4];
+      for (int blockY = 0; blockY < (height + 3) / 4; ++blockY) {
+	    for (int blockX = 0; blockX < (width + 3) / 4; ++blockX) {
+		  fetchBlock(pixels, width, height, components, blockX,
+			     blockY, block);
+		  switch (format) {
+		  case BlockFormat::BC1:
+			encodeColorBlock(block, next);
+			break;
+		  case BlockFormat::BC3:
+			encodeChannelBlock(block, 3, next);
+			encodeColorBlock(block, next + 8);
+			break;
+		  case BlockFormat::BC4:
+			encodeChannelBlock(block, 0, next);
+			break;
+		  case BlockFormat::BC5:
+			encodeChannelBlock(block, 0, next);
+			encodeChannelBlock(block, 1, next + 8);
+			break;
+		  }
+		  next += blockBytes(format);
+	    }
+      }
+      return out;
+}
+
+auto writeDDS(const std::string& path, std::uint64_t sourceHash,
+	      BlockFormat format, int width, int height,
+	      std::span<const std::vector<unsigned char>> levels) -> bool
+{
+      DDSHeader header{};
+      header.magic = DDS_MAGIC;
+      header.size = sizeof(DDSHeader) - sizeof(header.magic);
+      header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH |
+		     DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+      header.height = height;
+      header.width = width;
+      header.pitchOrLinearSize = compressedSize(format, width, height);
+      header.mipMapCount = levels.size();
+      header.reserved1[0] = ENCODER_TAG;
+      header.reserved1[1] = TEXTURE_ENCODER_VERSION;
+      header.reserved1[2] = std::uint32_t(sourceHash);
+      header.reserved1[3] = std::uint32_t(sourceHash >> 32);
+      header.pixelFormat.size = sizeof(DDSPixelFormat);
+      header.pixelFormat.flags = DDPF_FOURCC;
+      header.pixelFormat.fourCC = fourCCOf(format);
+      header.caps[0] = DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP;
+
+      // several workers may transcode the same source at once
+      static std::atomic<unsigned int> writes{0};
+      std::string temporary =
+	  path + ".tmp" + std::to_string(writes.fetch_add(1));
+      {
+	    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	    for (const std::vector<unsigned char>& level : levels) {
+		  file.write(reinterpret_cast<const char*>(level.data()),
+			     level.size());
+	    }
+	    if (!file) {
+		  std::remove(temporary.c_str());
+		  return false;
+	    }
+      }
+      return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+auto readDDS(const std::string& path, std::uint64_t sourceHash,
+	     CompressedTextureFile& texture) -> bool
+{
+      texture.file = MappedFile(path);
+      texture.levels.clear();
+      if (!texture.file.valid() || texture.file.size() < sizeof(DDSHeader)) {
+	    return false;
+      }
+      DDSHeader header;
+      std::memcpy(&header, texture.file.data(), sizeof(header));
+      if (header.magic != DDS_MAGIC || header.reserved1[0] != ENCODER_TAG ||
+	  header.reserved1[1] != TEXTURE_ENCODER_VERSION ||
+	  header.reserved1[2] != std::uint32_t(sourceHash) ||
+	  header.reserved1[3] != std::uint32_t(sourceHash >> 32) ||
+	  header.width == 0 || header.height == 0 ||
+	  header.width > MAX_DIMENSION || header.height > MAX_DIMENSION ||
+	  header.mipMapCount == 0 || header.mipMapCount > 32) {
+	    return false;
+      }
+      bool known = false;
+      for (BlockFormat format : {BlockFormat::BC1, BlockFormat::BC3,
+				 BlockFormat::BC4, BlockFormat::BC5}) {
+	    if (header.pixelFormat.fourCC == fourCCOf(format)) {
+		  texture.format = format;
+		  known = true;
+	    }
+      }
+      if (!known) {
+	    return false;
+      }
+
+      texture.width = header.width;
+      texture.height = header.height;
+      std::size_t offset = sizeof(header);
+      int width = texture.width;
+      int height = texture.height;
+      for (std::uint32_t level = 0; level < header.mipMapCount; ++level) {
+	    std::size_t size = compressedSize(texture.format, width, height);
+	    if (offset + size > texture.file.size()) {
+		  texture.levels.clear();
+		  return false;
+	    }
+	    texture.levels.emplace_back(texture.file.data() + offset, size);
+	    offset += size;
+	    width = std::max(width / 2, 1);
+	    height = std::max(height / 2, 1);
+      }
+      return true;
+}
+
+}  // namespace rg
@@ -0,0 +1,638 @@
+#include <rg/texture_loader.h>
+
+#include <glad/glad.h>
+#include <rg/gl_extensions.h>
+#include <rg/service_locator.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+namespace rg
+{
+namespace
+{
+// uploads staged in the last frames still being read by the GPU
+constexpr unsigned int UPLOAD_RING_BUFFERS = 3;
+
+auto formatOf(int components) -> GLenum
+{
+      switch (components) {
+      case 1:
+	    return GL_RED;
+      case 2:
+	    return GL_RG;
+      case 3:
+	    return GL_RGB;
+      default:
+	    return GL_RGBA;
+      }
+}
+
+// the smallest sized format holding components 8-bit channels
+auto sizedFormatOf(int components) -> GLenum
+{
+      switch (components) {
+      case 1:
+	    return GL_R8;
+      case 2:
+	    return GL_RG8;
+      case 3:
+	    return GL_RGB8;
+      default:
+	    return GL_RGBA8;
+      }
+}
+
+auto internalFormatOf(BlockFormat format) -> GLenum
+{
+      switch (format) {
+      case BlockFormat::BC1:
+	    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+      case BlockFormat::BC3:
+	    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+      case BlockFormat::BC4:
+	    return GL_COMPRESSED_RED_RGTC1;
+      case BlockFormat::BC5:
+	    return GL_COMPRESSED_RG_RGTC2;
+      }
+      return GL_RGBA;
+}
+
+auto usageName(TextureUsage usage) -> const char*
+{
+      switch (usage) {
+      case TextureUsage::Normal:
+	    return "normal";
+      case TextureUsage::Height:
+	    return "height";
+      default:
+	    return "color";
+      }
+}
+
+auto levelBytes(int width, int height, int components) -> std::size_t
+{
+      return std::size_t(width) * height * components;
+}
+
+auto opaque(const unsigned char* pixels, std::size_t texels) -> bool
+{
+      for (std::size_t i = 0; i < texels; ++i) {
+	    if (pixels[i * 4 + 3] != 255) {
+		  return false;
+	    }
+      }
+      return true;
+}
+
+// the block format for an image of components channels, none when it is
+// better left uncompressed
+auto blockFormatFor(TextureUsage usage, bool colorCompression,
+		    const unsigned char* pixels, int width, int height,
+		    int components) -> std::optional<BlockFormat>
+{
+      switch (usage) {
+      case TextureUsage::Height:
+	    return BlockFormat::BC4;
+      case TextureUsage::Normal:
+	    if (components >= 2) {
+		  return BlockFormat::BC5;
+	    }
+	    return std::nullopt;
+      default:
+	    if (!colorCompression || components < 3) {
+		  return std::nullopt;
+	    }
+	    if (components == 4 &&
+		!opaque(pixels, std::size_t(width) * height)) {
+		  return BlockFormat::BC3;
+	    }
+	    return BlockFormat::BC1;
+      }
+}
+
+// Keeps the first keep of the components channels of each texel, in place.
+void dropChannels(unsigned char* pixels, std::size_t texels, int components,
+		  int keep)
+{
+      for (std::size_t i = 0; i < texels; ++i) {
+	    for (int c = 0; c < keep; ++c) {
+		  pixels[i * keep + c] = pixels[i * components + c];
+	    }
+      }
+}
+
+// The first channel of each source, resampled to the largest source with
+// nearest filtering, interleaved. Null when no source names a file.
+auto packChannels(const std::vector<ChannelSource>& channels, int& width,
+		  int& height) -> std::shared_ptr<const unsigned char>
+{
+      struct Source {
+	    std::unique_ptr<unsigned char, void (*)(void*)> pixels{
+		nullptr, stbi_image_free};
+	    int width = 0;
+	    int height = 0;
+	    int components = 0;
+      };
+      std::vector<Source> sources(channels.size());
+      width = 1;
+      height = 1;
+      for (std::size_t c = 0; c < channels.size(); ++c) {
+	    Source& source = sources[c];
+	    if (channels[c].path.empty()) {
+		  continue;
+	    }
+	    // loaded as stored; asking stb_image for one component would
+	    // mix color channels into luminance
+	    source.pixels.reset(stbi_load(channels[c].path.c_str(),
+					  &source.width, &source.height,
+					  &source.components, 0));
+	    if (source.pixels) {
+		  width = std::max(width, source.width);
+		  height = std::max(height, source.height);
+	    } else {
+		  std::cout << "Texture failed to load at path: "
+			    << channels[c].path << std::endl;
+	    }
+      }
+
+      int components = static_cast<int>(channels.size());
+      std::shared_ptr<unsigned char> pixels(
+	  new unsigned char[levelBytes(width, height, components)],
+	  std::default_delete<unsigned char[]>());
+      unsigned char* out = pixels.get();
+      for (int y = 0; y < height; ++y) {
+	    for (int x = 0; x < width; ++x) {
+		  for (int c = 0; c < components; ++c) {
+			const Source& source = sources[c];
+			if (!source.pixels) {
+			      *out++ = channels[c].value;
+			      continue;
+			}
+			std::size_t sx = std::size_t(x) * source.width / width;
+			std::size_t sy =
+			    std::size_t(y) * source.height / height;
+			std::size_t texel =
+			    (sy * source.width + sx) * source.components;
+			*out++ = source.pixels.get()[texel];
+		  }
+	    }
+      }
+      return pixels;
+}
+
+// 2x2 box filter, the same one glGenerateMipmap uses on common drivers.
+// Odd edges repeat their last texel.
+auto downsample(const unsigned char* source, int width, int height,
+		int components) -> std::shared_ptr<const unsigned char>
+{
+      int halfWidth = std::max(width / 2, 1);
+      int halfHeight = std::max(height / 2, 1);
+      std::shared_ptr<unsigned char> pixels(
+	  new unsigned char[levelBytes(halfWidth, halfHeight, components)],
+	  std::default_delete<unsigned char[]>());
+      unsigned char* out = pixels.get();
+      for (int y = 0; y < halfHeight; ++y) {
+	    const unsigned char* row0 =
+		source + std::size_t(std::min(2 * y, height - 1)) * width *
+			     components;
+	    const unsigned char* row1 =
+		source + std::size_t(std::min(2 * y + 1, height - 1)) *
+			     width * components;
+	    for (int x = 0; x < halfWidth; ++x) {
+		  int x0 = std::min(2 * x, width - 1) * components;
+		  int x1 = std::min(2 * x + 1, width - 1) * components;
+		  for (int c = 0; c < components; ++c) {
+			*out++ = (row0[x0 + c] + row0[x1 + c] +
+				  row1[x0 + c] + row1[x1 + c] + 2) /
+				 4;
+		  }
+	    }
+      }
+      return pixels;
+}
+}  // namespace
+
+auto TextureLoader::load(const std::string& path, TextureUsage usage,
+			 bool clampTransparent) -> unsigned int
+{
+      Request request;
+      request.path = path;
+      request.usage = usage;
+      request.clampTransparent = clampTransparent;
+      return submit(std::move(request));
+}
+
+auto TextureLoader::loadPacked(const std::vector<ChannelSource>& channels)
+    -> unsigned int
+{
+      Request request;
+      request.channels = channels;
+      // the name of the texture in messages
+      for (const ChannelSource& channel : channels) {
+	    request.path += (request.path.empty() ? "" : "|") +
+			    (channel.path.empty()
+				 ? std::to_string(channel.value)
+				 : channel.path);
+      }
+      return submit(std::move(request));
+}
+
+auto TextureLoader::submit(Request request) -> unsigned int
+{
+      unsigned int texture = 0;
+      glGenTextures(1, &texture);
+      const unsigned char white[4] = {255, 255, 255, 255};
+      ServiceLocator::Get().getGLState().bindTexture(0, GL_TEXTURE_2D,
+						     texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+		   GL_UNSIGNED_BYTE, white);
+      // no mips yet, a mipmapped filter would leave it incomplete
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+      request.texture = texture;
+      request.id = ++m_nextRequest;
+      request.mipmaps = cpuMipmaps;
+      request.compress = compressTextures;
+      request.colorCompression = glExtensions().textureCompressionS3TC;
+      ++m_stats.pending;
+      m_requests[texture] = request.id;
+      ServiceLocator::Get().getThreadPool().submit([this, request] {
+	    DecodedImage image = decode(request);
+	    {
+		  std::lock_guard<std::mutex> lock(m_mutex);
+		  m_decoded.push_back(std::move(image));
+	    }
+	    m_decodedCondition.notify_one();
+      });
+      return texture;
+}
+
+// Runs on a worker. stb_image only shares the flip flag between threads,
+// which is set once before anything is loaded.
+auto TextureLoader::decode(const Request& request) -> DecodedImage
+{
+      DecodedImage image;
+      image.request = request;
+
+      // a transcoded copy from an earlier run skips decoding altogether
+      bool packed = !request.channels.empty();
+      std::uint64_t sourceHash = 0;
+      std::string cachePath;
+      // packed channels are unrelated, BC1 endpoints would blend them
+      if (request.compress && !packed) {
+	    sourceHash = hashFile(request.path);
+	    cachePath = request.path + "." + usageName(request.usage) + ".dds";
+      }
+      if (sourceHash != 0) {
+	    auto cached = std::make_shared<CompressedTextureFile>();
+	    bool usable = readDDS(cachePath, sourceHash, *cached) &&
+			  (request.colorCompression ||
+			   cached->format == BlockFormat::BC4 ||
+			   cached->format == BlockFormat::BC5);
+	    if (usable) {
+		  image.blockFormat = cached->format;
+		  image.transparent = cached->format == BlockFormat::BC3;
+		  int width = cached->width;
+		  int height = cached->height;
+		  for (std::span<const std::byte> data : cached->levels) {
+			Level level;
+			level.width = width;
+			level.height = height;
+			level.size = data.size();
+			// the levels keep the mapping alive
+			level.pixels = std::shared_ptr<const unsigned char>(
+			    cached, reinterpret_cast<const unsigned char*>(
+					data.data()));
+			image.levels.push_back(std::move(level));
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		  }
+		  return image;
+	    }
+      }
+
+      // only the channels the usage reads are kept, in the fewest bytes
+      Level base;
+      const unsigned char* data = nullptr;
+      if (packed) {
+	    base.pixels = packChannels(request.channels, base.width,
+				       base.height);
+	    image.components = static_cast<int>(request.channels.size());
+	    data = base.pixels.get();
+      } else {
+	    // height maps are loaded as stored and keep their first channel;
+	    // asking stb_image for one component would mix color channels
+	    // into luminance
+	    int requested = 0;
+	    if (request.usage == TextureUsage::Normal) {
+		  requested = 3;
+	    }
+	    int fileComponents = 0;
+	    unsigned char* loaded =
+		stbi_load(request.path.c_str(), &base.width, &base.height,
+			  &fileComponents, requested);
+	    if (loaded == nullptr) {
+		  return image;
+	    }
+	    image.components = requested != 0 ? requested : fileComponents;
+	    // Z is rebuilt from X and Y in the shaders
+	    if (request.usage == TextureUsage::Normal) {
+		  dropChannels(loaded, std::size_t(base.width) * base.height,
+			       image.components, 2);
+		  image.components = 2;
+	    } else if (request.usage == TextureUsage::Height) {
+		  dropChannels(loaded, std::size_t(base.width) * base.height,
+			       image.components, 1);
+		  image.components = 1;
+	    }
+	    base.pixels.reset(loaded, stbi_image_free);
+	    data = loaded;
+      }
+      std::optional<BlockFormat> blockFormat;
+      if (request.compress && !packed) {
+	    blockFormat =
+		blockFormatFor(request.usage, request.colorCompression, data,
+			       base.width, base.height, image.components);
+      }
+      image.transparent = image.components == 4 &&
+			  blockFormat != BlockFormat::BC1;
+      base.size = levelBytes(base.width, base.height, image.components);
+      image.levels.push_back(std::move(base));
+
+      // block compressed levels cannot be generated by the driver
+      bool mipmaps = request.mipmaps || blockFormat.has_value();
+      while (mipmaps && (image.levels.back().width > 1 ||
+			 image.levels.back().height > 1)) {
+	    const Level& previous = image.levels.back();
+	    Level next;
+	    next.width = std::max(previous.width / 2, 1);
+	    next.height = std::max(previous.height / 2, 1);
+	    next.size = levelBytes(next.width, next.height, image.components);
+	    next.pixels = downsample(previous.pixels.get(), previous.width,
+				     previous.height, image.components);
+	    image.levels.push_back(std::move(next));
+      }
+
+      if (!blockFormat) {
+	    return image;
+      }
+      std::vector<std::vector<unsigned char>> blocks;
+      blocks.reserve(image.levels.size());
+      for (const Level& level : image.levels) {
+	    blocks.push_back(compressImage(level.pixels.get(), level.width,
+					   level.height, image.components,
+					   *blockFormat));
+      }
+      const Level& top = image.levels.front();
+      if (sourceHash != 0 && !writeDDS(cachePath, sourceHash, *blockFormat,
+				       top.width, top.height, blocks)) {
+	    std::cout << "ERROR::TEXTURE:: could not write " << cachePath
+		      << '\n';
+      }
+      for (std::size_t i = 0; i < image.levels.size(); ++i) {
+	    auto compressed = std::make_shared<std::vector<unsigned char>>(
+		std::move(blocks[i]));
+	    image.levels[i].size = compressed->size();
+	    image.levels[i].pixels =
+		std::shared_ptr<const unsigned char>(compressed,
+						     compressed->data());
+      }
+      image.blockFormat = blockFormat;
+      return image;
+}
+
+auto TextureLoader::current(const Request& request) const -> bool
+{
+      auto found = m_requests.find(request.texture);
+      return found != m_requests.end() && found->second == request.id;
+}
+
+// Queues the decoded images for streaming. Images that failed, or whose
+// texture was released while they decoded, are done with.
+void TextureLoader::collectDecoded()
+{
+      std::deque<DecodedImage> decoded;
+      {
+	    std::lock_guard<std::mutex> lock(m_mutex);
+	    decoded.swap(m_decoded);
+      }
+      for (DecodedImage& image : decoded) {
+	    if (!current(image.request)) {
+		  --m_stats.pending;
+		  continue;
+	    }
+	    if (image.levels.empty()) {
+		  std::cout << "Texture failed to load at path: "
+			    << image.request.path << std::endl;
+		  m_requests.erase(image.request.texture);
+		  --m_stats.pending;
+		  continue;
+	    }
+	    std::size_t levels = image.levels.size();
+	    m_streaming.push_back(Streaming{std::move(image), levels, levels});
+      }
+}
+
+auto TextureLoader::stream(std::size_t byteBudget, bool wait) -> unsigned int
+{
+      collectDecoded();
+      std::erase_if(m_streaming, [this](const Streaming& streaming) {
+	    if (current(streaming.image.request)) {
+		  return false;
+	    }
+	    --m_stats.pending;
+	    return true;
+      });
+      m_stats.streaming = m_streaming.size();
+      if (m_streaming.empty()) {
+	    return 0;
+      }
+
+      bool staging = false;
+      if (pixelBuffers) {
+	    if (!m_uploadRing) {
+		  m_uploadRing = std::make_unique<UploadRing>(
+		      UPLOAD_RING_BUFFERS, stagingBufferBytes);
+	    }
+	    // every buffer still in flight, the GPU is behind already
+	    if (!m_uploadRing->begin(wait)) {
+		  return 0;
+	    }
+	    staging = true;
+      }
+
+      struct Step {
+	    Streaming* streaming = nullptr;
+	    std::size_t level = 0;
+	    std::optional<std::size_t> offset;  // in the staging buffer
+      };
+      std::vector<Step> steps;
+      std::size_t bytes = 0;
+      bool more = true;
+      while (more && bytes < byteBudget) {
+	    more = false;
+	    for (Streaming& streaming : m_streaming) {
+		  if (streaming.remaining == 0) {
+			continue;
+		  }
+		  std::size_t level = streaming.remaining - 1;
+		  const Level& data = streaming.image.levels[level];
+		  std::optional<std::size_t> offset;
+		  if (staging) {
+			offset = m_uploadRing->stage(data.pixels.get(),
+						     data.size);
+			// the rest waits for the next buffer
+			if (!offset &&
+			    data.size <= m_uploadRing->bufferBytes()) {
+			      more = false;
+			      break;
+			}
+		  }
+		  steps.push_back(Step{&streaming, level, offset});
+		  --streaming.remaining;
+		  bytes += data.size;
+		  more = true;
+		  if (bytes >= byteBudget) {
+			break;
+		  }
+	    }
+      }
+
+      // rows of one and three channel levels are not 4 byte aligned
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      if (staging) {
+	    m_uploadRing->unmap();
+	    for (const Step& step : steps) {
+		  if (step.offset) {
+			uploadLevel(step.streaming->image, step.level,
+				    reinterpret_cast<const void*>(
+					*step.offset));
+		  }
+	    }
+	    m_uploadRing->end();
+      }
+      for (const Step& step : steps) {
+	    if (!step.offset) {
+		  const Level& data = step.streaming->image.levels[step.level];
+		  uploadLevel(step.streaming->image, step.level,
+			      data.pixels.get());
+	    }
+      }
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+      for (Streaming& streaming : m_streaming) {
+	    if (streaming.remaining != streaming.baseLevel) {
+		  showUploadedLevels(streaming);
+	    }
+      }
+      std::erase_if(m_streaming, [](const Streaming& streaming) {
+	    return streaming.baseLevel == 0;
+      });
+      m_stats.streaming = m_streaming.size();
+      return steps.size();
+}
+
+// pixels is an offset into the bound staging buffer when there is one
+void TextureLoader::uploadLevel(const DecodedImage& image, std::size_t level,
+				const void* pixels)
+{
+      ServiceLocator::Get().getGLState().bindTexture(0, GL_TEXTURE_2D,
+						     image.request.texture);
+      const Level& data = image.levels[level];
+      if (image.blockFormat) {
+	    glCompressedTexImage2D(GL_TEXTURE_2D, level,
+				   internalFormatOf(*image.blockFormat),
+				   data.width, data.height, 0, data.size,
+				   pixels);
+      } else {
+	    glTexImage2D(GL_TEXTURE_2D, level, sizedFormatOf(image.components),
+			 data.width, data.height, 0,
+			 formatOf(image.components), GL_UNSIGNED_BYTE,
+			 pixels);
+      }
+      m_stats.uploadedBytes += data.size;
+      m_uploadedBytes[image.request.texture] += data.size;
+}
+
+// Moves the base level down to the last uploaded one. Levels above it still
+// hold the placeholder and are left out of sampling until then.
+void TextureLoader::showUploadedLevels(Streaming& streaming)
+{
+      const DecodedImage& image = streaming.image;
+      std::size_t levels = image.levels.size();
+      ServiceLocator::Get().getGLState().bindTexture(0, GL_TEXTURE_2D,
+						     image.request.texture);
+      if (streaming.baseLevel == levels) {
+	    GLint wrap = image.request.clampTransparent && image.transparent
+			     ? GL_CLAMP_TO_EDGE
+			     : GL_REPEAT;
+	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			    GL_LINEAR_MIPMAP_LINEAR);
+	    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	    // a single level gets its mips from the driver below
+	    if (levels > 1) {
+		  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+				  levels - 1);
+	    }
+      }
+      streaming.baseLevel = streaming.remaining;
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,
+		      streaming.baseLevel);
+      if (streaming.baseLevel > 0) {
+	    return;
+      }
+
+      if (levels == 1 && !image.blockFormat) {
+	    glGenerateMipmap(GL_TEXTURE_2D);
+      }
+      m_requests.erase(image.request.texture);
+      --m_stats.pending;
+      ++m_stats.uploaded;
+      if (image.blockFormat) {
+	    ++m_stats.compressed;
+      }
+}
+
+void TextureLoader::release(unsigned int texture)
+{
+      m_requests.erase(texture);
+      m_uploadedBytes.erase(texture);
+      ServiceLocator::Get().getGLState().forgetTexture(texture);
+      glDeleteTextures(1, &texture);
+}
+
+void TextureLoader::release()
+{
+      m_uploadRing.reset();
+}
+
+auto TextureLoader::uploadedBytes(unsigned int texture) const -> std::size_t
+{
+      auto found = m_uploadedBytes.find(texture);
+      return found != m_uploadedBytes.end() ? found->second : 0;
+}
+
+auto TextureLoader::uploadPending(std::size_t byteBudget) -> unsigned int
+{
+      return stream(byteBudget, false);
+}
+
+void TextureLoader::finish()
+{
+      while (m_stats.pending > 0) {
+	    if (m_streaming.empty()) {
+		  std::unique_lock<std::mutex> lock(m_mutex);
+		  m_decodedCondition.wait(
+			  lock, [this] { return !m_decoded.empty(); });
+	    }
+	    stream(SIZE_MAX, true);
+      }
+}
+
+}  // namespace rg
@@ -0,0 +1,52 @@
+#include <rg/thread_pool.h>
+
+#include <algorithm>
+
+namespace rg
+{
+
+ThreadPool::ThreadPool()
+{
+      unsigned int count =
+	  std::max(std::thread::hardware_concurrency(), 2U) - 1;
+      m_threads.reserve(count);
+      for (unsigned int i = 0; i < count; ++i) {
+	    m_threads.emplace_back([this] { run(); });
+      }
+}
+
+// Tasks that did not start yet are dropped, their futures report a broken
+// promise.
+ThreadPool::~ThreadPool()
+{
+      {
+	    std::lock_guard<std::mutex> lock(m_mutex);
+	    m_stopping = true;
+	    m_tasks.clear();
+      }
+      m_condition.notify_all();
+      for (std::thread& thread : m_threads) {
+	    thread.join();
+      }
+}
+
+void ThreadPool::run()
+{
+      while (true) {
+	    std::function<void()> task;
+	    {
+		  std::unique_lock<std::mutex> lock(m_mutex);
+		  m_condition.wait(lock, [this] {
+			return m_stopping || !m_tasks.empty();
+		  });
+		  if (m_stopping) {
+			return;
+		  }
+		  task = std::move(m_tasks.front());
+		  m_tasks.pop_front();
+	    }
+	    task();
+      }
+}
+
+}  // namespace rg
@@ -0,0 +1,91 @@
+#include <rg/upload_ring.h>
+
+#include <cstring>
+
+namespace rg
+{
+namespace
+{
+// keeps every staged level at an offset any pixel type can be read from
+constexpr std::size_t STAGING_ALIGNMENT = 16;
+}  // namespace
+
+UploadRing::UploadRing(unsigned int buffers, std::size_t bufferBytes)
+    : m_buffers(buffers), m_bufferBytes(bufferBytes)
+{
+      for (Buffer& buffer : m_buffers) {
+	    glGenBuffers(1, &buffer.name);
+	    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.name);
+	    glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bufferBytes, nullptr,
+			 GL_STREAM_DRAW);
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+UploadRing::~UploadRing()
+{
+      for (Buffer& buffer : m_buffers) {
+	    if (buffer.fence != nullptr) {
+		  glDeleteSync(buffer.fence);
+	    }
+	    glDeleteBuffers(1, &buffer.name);
+      }
+}
+
+auto UploadRing::begin(bool wait) -> bool
+{
+      Buffer& buffer = m_buffers[m_current];
+      if (buffer.fence != nullptr) {
+	    GLenum status =
+		wait ? glClientWaitSync(buffer.fence,
+					GL_SYNC_FLUSH_COMMANDS_BIT,
+					GL_TIMEOUT_IGNORED)
+		     : glClientWaitSync(buffer.fence, 0, 0);
+	    if (status == GL_TIMEOUT_EXPIRED) {
+		  return false;
+	    }
+	    glDeleteSync(buffer.fence);
+	    buffer.fence = nullptr;
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.name);
+      // the fence already ordered us after the GPU, the driver need not
+      m_mapped = static_cast<unsigned char*>(glMapBufferRange(
+	  GL_PIXEL_UNPACK_BUFFER, 0, m_bufferBytes,
+	  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+	      GL_MAP_UNSYNCHRONIZED_BIT));
+      if (m_mapped == nullptr) {
+	    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	    return false;
+      }
+      m_used = 0;
+      return true;
+}
+
+auto UploadRing::stage(const void* data, std::size_t size)
+    -> std::optional<std::size_t>
+{
+      std::size_t offset = (m_used + STAGING_ALIGNMENT - 1) &
+			   ~(STAGING_ALIGNMENT - 1);
+      if (m_mapped == nullptr || offset + size > m_bufferBytes) {
+	    return std::nullopt;
+      }
+      std::memcpy(m_mapped + offset, data, size);
+      m_used = offset + size;
+      return offset;
+}
+
+void UploadRing::unmap()
+{
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      m_mapped = nullptr;
+}
+
+void UploadRing::end()
+{
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      m_buffers[m_current].fence =
+	  glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      m_current = (m_current + 1) % m_buffers.size();
+}
+
+}  // namespace rg